@@ -0,0 +1,336 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "incremental.h"
+
+object *_roots[MAX_ROOTS];
+int _rp;
+
+gc_phase_type gc_phase;
+barrier_type gc_barrier = BARRIER_DIJKSTRA;    // 写入屏障的方式
+
+void *heap_start;
+int num_nodes;
+int free_count;
+node *free_list;        // 空闲链表的表头
+int sweeping;           // 清除阶段下一个要清除的单元
+
+object **mark_stack;    // 标记栈，其中的对象是灰色
+int msp;
+int mark_stack_capacity;
+
+int step_budget;
+
+int collections;
+int full_collections;
+long max_pause;
+
+/**
+ * @brief 第i个单元
+ *
+ * @param i
+ * @return node*
+ */
+node *node_at(int i);
+
+/**
+ * @brief 把白色对象涂成灰色
+ *  1. 对象放入标记栈，Steele的算法中从标记栈取出时才设置标识位
+ *
+ * @param obj
+ */
+void mark(object *obj);
+
+/**
+ * @brief 根查找阶段
+ *  1. 标记GC ROOTS直接引用的对象，Yuasa的算法以此时的引用关系为基础
+ *  2. 计算之后每一步的工作量，标记和清除最多处理2倍的单元数，要在空闲单元用完之前完成
+ *
+ */
+void root_scan_phase();
+
+/**
+ * @brief 标记阶段，最多从标记栈中取出budget个对象
+ *  1. 标记栈为空时，Dijkstra和Steele的算法重新搜索GC ROOTS，有新的灰色对象就继续标记
+ *  2. 没有灰色对象时进入清除阶段
+ *
+ * @param budget
+ */
+void incremental_mark_phase(int budget);
+
+/**
+ * @brief 清除阶段，最多清除budget个单元
+ *  1. 白色对象所在的单元放入空闲链表，黑色对象变为白色
+ *  2. 清除完所有单元后，这一轮GC结束
+ *
+ * @param budget
+ */
+void incremental_sweep_phase(int budget);
+
+node *node_at(int i) {
+    return (node *) (heap_start + (long) i * NODE_SIZE);
+}
+
+void push(object *obj) {
+    if (msp == mark_stack_capacity) {
+        mark_stack_capacity = mark_stack_capacity ? mark_stack_capacity * 2 : 256;
+        mark_stack = (object **) realloc(mark_stack, mark_stack_capacity * sizeof(object *));
+    }
+    mark_stack[msp++] = obj;
+}
+
+void mark(object *obj) {
+    if (!obj || obj->marked) {
+        return;
+    }
+
+    if (gc_barrier != BARRIER_STEELE) {
+        obj->marked = TRUE;
+    }
+    push(obj);
+}
+
+void root_scan_phase() {
+    printf("collection ...\n");
+
+    for (int i = 0; i < _rp; ++i) {
+        mark(_roots[i]);
+    }
+
+    step_budget = 2 * num_nodes / (free_count + 1) + 1;
+    gc_phase = GC_MARK;
+}
+
+void incremental_mark_phase(int budget) {
+    for (int i = 0; i < budget; ++i) {
+        if (msp == 0) {
+            // GC ROOTS在标记过程中可能发生了变化
+            if (gc_barrier != BARRIER_YUASA) {
+                for (int r = 0; r < _rp; ++r) {
+                    mark(_roots[r]);
+                }
+            }
+
+            if (msp == 0) {
+                gc_phase = GC_SWEEP;
+                sweeping = 0;
+                return;
+            }
+        }
+
+        object *obj = mark_stack[--msp];
+        if (gc_barrier == BARRIER_STEELE) {
+            if (obj->marked) {
+                continue;
+            }
+            obj->marked = TRUE;
+        }
+
+        for (int f = 0; f < obj->clss->num_fields; ++f) {
+            mark(*(object **) ((void *) obj + obj->clss->field_offsets[f]));
+        }
+    }
+}
+
+void incremental_sweep_phase(int budget) {
+    for (int i = 0; i < budget; ++i) {
+        if (sweeping == num_nodes) {
+            gc_phase = GC_ROOT_SCAN;
+            collections++;
+            return;
+        }
+
+        node *_node = node_at(sweeping++);
+        if (!_node->used) {
+            continue;
+        }
+
+        object *obj = _node->data;
+        if (obj->marked) {
+            obj->marked = FALSE;
+        } else {
+            //回收对象所属的node
+            memset(obj, 0, _node->size);
+            _node->used = FALSE;
+            _node->data = NULL;
+            _node->size = 0;
+
+            _node->next = free_list;
+            free_list = _node;
+            free_count++;
+        }
+    }
+}
+
+void gc_init(int size) {
+    if (size > MAX_HEAP_SIZE) {
+        size = MAX_HEAP_SIZE;
+    }
+
+    num_nodes = size < NODE_SIZE ? 1 : size / NODE_SIZE;
+    heap_start = malloc((long) num_nodes * NODE_SIZE);
+
+    // 空闲链表按地址顺序排列
+    free_list = NULL;
+    for (int i = num_nodes - 1; i >= 0; --i) {
+        node *_node = node_at(i);
+        _node->next = free_list;
+        _node->used = FALSE;
+        _node->size = 0;
+        _node->data = NULL;
+        free_list = _node;
+    }
+    free_count = num_nodes;
+
+    _rp = 0;
+    msp = 0;
+    gc_phase = GC_ROOT_SCAN;
+    sweeping = 0;
+    step_budget = 0;
+
+    collections = 0;
+    full_collections = 0;
+    max_pause = 0;
+}
+
+void gc() {
+    if (gc_phase == GC_ROOT_SCAN) {
+        root_scan_phase();
+    }
+
+    while (gc_phase == GC_MARK) {
+        incremental_mark_phase(INT_MAX);
+    }
+
+    while (gc_phase == GC_SWEEP) {
+        incremental_sweep_phase(INT_MAX);
+    }
+}
+
+void gc_step() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    switch (gc_phase) {
+        case GC_ROOT_SCAN:
+            root_scan_phase();
+            break;
+        case GC_MARK:
+            incremental_mark_phase(step_budget);
+            break;
+        case GC_SWEEP:
+            incremental_sweep_phase(step_budget);
+            break;
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    long pause = (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+    if (pause > max_pause) {
+        max_pause = pause;
+    }
+}
+
+void gc_done() {
+    free(heap_start);
+    free(mark_stack);
+    heap_start = NULL;
+    mark_stack = NULL;
+    mark_stack_capacity = 0;
+    free_list = NULL;
+}
+
+object* gc_alloc(class_descriptor* clss) {
+    if (clss->size > NODE_SIZE - (int) sizeof(node)) {
+        printf("Object is too large!\n");
+        abort();
+    }
+
+    if (gc_phase != GC_ROOT_SCAN || (long) free_count * 100 < (long) num_nodes * GC_THRESHOLD) {
+        gc_step();
+    }
+
+    // 增量GC赶不上分配，一次性完成这一轮GC
+    if (!free_list) {
+        full_collections++;
+        gc();
+    }
+
+    // 这一轮标记阶段分配的对象都是黑色，再执行一轮才能回收其中的垃圾
+    if (!free_list) {
+        gc();
+    }
+
+    //再找不到真的没了……
+    if (!free_list) {
+        printf("Allocation Failed!OutOfMemory...\n");
+        abort();
+    }
+
+    node *_node = free_list;
+    free_list = free_list->next;
+    free_count--;
+
+    //将新对象分配在free_list的节点数据之后，node单元的空间内除了sizeof(node)，剩下的地址空间都用于存储对象
+    object *new_obj = (void *) _node + sizeof(node);
+    new_obj->clss = clss;
+
+    // 标记阶段分配的对象涂成黑色，清除阶段分配在还没有清除的单元中的对象也不能被清除
+    int index = ((void *) _node - heap_start) / NODE_SIZE;
+    new_obj->marked = gc_phase == GC_MARK || (gc_phase == GC_SWEEP && index >= sweeping);
+
+    _node->used = TRUE;
+    _node->data = new_obj;
+    _node->size = clss->size;
+
+    for (int i = 0; i < clss->num_fields; ++i) {
+        *(object **) ((void *) new_obj + clss->field_offsets[i]) = NULL;
+    }
+
+    return new_obj;
+}
+
+void gc_set_barrier(barrier_type barrier) {
+    gc_barrier = barrier;
+}
+
+void gc_update_ptr(object* obj, object** field_ref, object* new_obj) {
+    if (gc_phase == GC_MARK) {
+        switch (gc_barrier) {
+            case BARRIER_DIJKSTRA:
+                mark(new_obj);
+                break;
+            case BARRIER_STEELE:
+                // 黑色对象引用白色或者灰色对象时重新涂成灰色
+                if (obj->marked && new_obj && !new_obj->marked) {
+                    obj->marked = FALSE;
+                    push(obj);
+                }
+                break;
+            case BARRIER_YUASA:
+                mark(*field_ref);
+                break;
+        }
+    }
+
+    *field_ref = new_obj;
+}
+
+char *gc_get_state() {
+    static char *phases[] = {"root scan", "mark", "sweep"};
+    static char *barriers[] = {"dijkstra", "steele", "yuasa"};
+
+    printf("Heap Usage:\n");
+    printf("   nodes       = %d (%d free)\n", num_nodes, free_count);
+    printf("   phase       = %s\n", phases[gc_phase]);
+    printf("   barrier     = %s\n", barriers[gc_barrier]);
+    printf("   collections = %d (%d full)\n", collections, full_collections);
+    printf("   max pause   = %ld ns\n", max_pause);
+
+    return NULL;
+}
+
+int gc_num_roots() {
+    return _rp;
+}
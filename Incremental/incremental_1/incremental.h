@@ -0,0 +1,192 @@
+#ifndef GC_IMPL_INCREMENTAL_GC_H
+#define GC_IMPL_INCREMENTAL_GC_H
+
+#endif
+
+/**
+ * @brief 1字节的byte类型，用来做标识位
+ *
+ */
+typedef unsigned char byte;
+
+/**
+ * @brief 类描述
+ *
+ */
+typedef struct class_descriptor {
+    char *name;         // 类名称
+    int size;           // 类大小，即对应sizeof(struct)
+    int num_fields;     // 属性数量
+    int *field_offsets; // 类中的属性偏移，即所有属性在struct中的偏移量(字节)
+} class_descriptor;
+
+/**
+ * @brief 基本对象类型
+ *  1. 所有对象都继承于Object
+ *  2. C中没有继承的概念，不过可以通过定义相同属性来实现，所有“继承”Object的struct，都需要将class/marked属性定义在开头
+ *  3. 白色：没有标记；灰色：在标记栈中；黑色：已标记并且不在标记栈中
+ *
+ */
+typedef struct _object object;
+struct _object {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+};
+
+/**
+ * @brief free-list的单元节点
+ *  1. 和mark_sweep_3一样，每个单元只存放一个Object，不允许分配超过此单元大小的内存
+ *  2. 所有单元在一块连续的内存中，清除阶段按地址顺序一点点推进
+ *
+ */
+typedef struct _node node;
+struct _node {
+    node *next;     // 空闲链表中的下一个单元
+    byte used;      // 是否使用
+    int size;
+    object *data;   // 单元中的数据
+};
+
+#define MAX_ROOTS 100
+
+#define NODE_SIZE 128   // free-list单元大小(B)
+
+#define MAX_HEAP_SIZE 1024 * 1024 * 1024 // 1GB
+
+#define GC_THRESHOLD 25 // 空闲单元的比例(%)低于该值时开始一轮GC
+
+/**
+ * @brief GC的阶段
+ *
+ */
+typedef enum {
+    GC_ROOT_SCAN,   // 没有在GC，下一步标记GC ROOTS直接引用的对象
+    GC_MARK,        // 每一步从标记栈中取出一定数量的对象，把它们的子对象涂成灰色
+    GC_SWEEP        // 每一步清除一定数量的单元
+} gc_phase_type;
+
+/**
+ * @brief 写入屏障的方式
+ *
+ */
+typedef enum {
+    BARRIER_DIJKSTRA,   // 新引用的白色对象涂成灰色，标记栈为空时重新搜索GC ROOTS
+    BARRIER_STEELE,     // 黑色对象引用白色对象时，把黑色对象重新涂成灰色，标记栈为空时重新搜索GC ROOTS
+    BARRIER_YUASA       // 被删除引用的白色对象涂成灰色，保留GC开始时的活动对象，不需要重新搜索GC ROOTS
+} barrier_type;
+
+const static byte TRUE = 1;
+const static byte FALSE = 0;
+
+/**
+ * @brief GC ROOTS
+ *  1. 修改GC ROOTS不经过写入屏障
+ *
+ */
+extern object *_roots[MAX_ROOTS];
+
+// GC ROOT 的当前下标，即记录到了第几个元素
+extern int _rp;
+
+// 当前GC的阶段
+extern gc_phase_type gc_phase;
+
+// 所有单元的起始地址
+extern void *heap_start;
+
+// 单元总数
+extern int num_nodes;
+
+// 空闲单元数
+extern int free_count;
+
+// 完成的GC轮数
+extern int collections;
+
+// 空闲链表用完时，一次性完成当前这一轮GC的次数
+extern int full_collections;
+
+// 每一步的工作量，每一轮GC开始时根据空闲单元的比例计算
+extern int step_budget;
+
+// 一步增量GC的最长时间(ns)，只计算这个线程的CPU时间，不包括被调度出去的时间
+extern long max_pause;
+
+/**
+ * @brief 初始化GC
+ *
+ * @param size 堆大小
+ */
+extern void gc_init(int size);
+
+/**
+ * @brief 执行GC，一次性完成当前这一轮GC，没有在GC时执行完整的一轮
+ *
+ */
+extern void gc();
+
+/**
+ * @brief 执行一步增量GC
+ *  1. 根查找阶段标记GC ROOTS直接引用的对象，并根据空闲单元数计算之后每一步的工作量
+ *  2. 标记阶段从标记栈中取出不超过工作量的对象
+ *  3. 清除阶段清除不超过工作量的单元
+ *
+ */
+extern void gc_step();
+
+/**
+ * @brief GC结束，彻底清理堆
+ *
+ */
+extern void gc_done();
+
+/**
+ * @brief 在GC堆上分配指定类型的内存
+ *  1. 空闲单元少于GC_THRESHOLD或者正在GC时，先执行一步增量GC
+ *  2. 标记阶段分配的对象是黑色，清除阶段分配在还没有清除的单元中的对象也是黑色
+ *  3. 空闲链表用完时一次性完成当前这一轮GC
+ *
+ * @param clss 需要分配的类型
+ * @return object* 分配的对象指针
+ */
+extern object* gc_alloc(class_descriptor* clss);
+
+/**
+ * @brief 设置写入屏障的方式，需要在gc_init之前调用
+ *
+ * @param barrier
+ */
+extern void gc_set_barrier(barrier_type barrier);
+
+/**
+ * @brief 修改引用(写入屏障)
+ *  1. 只在标记阶段生效
+ *
+ * @param obj 原对象
+ * @param field_ref 原对象的属性指针
+ * @param new_obj 新对象指针
+ */
+extern void gc_update_ptr(object* obj, object** field_ref, object* new_obj);
+
+/**
+ * @brief DUMP GC状态
+ *
+ * @return char*
+ */
+extern char *gc_get_state();
+
+/**
+ * @brief 获取GC ROOTS数量
+ *
+ * @return int ROOTS数量
+ */
+extern int gc_num_roots();
+
+// 暂存GC ROOTS下标
+#define gc_save_rp int __rp = _rp;
+
+// 将对象添加到GC ROOTS
+#define gc_add_root(p) _roots[_rp++] = (object *)(p);
+
+// 恢复GC ROOTS下标
+#define gc_restore_roots  _rp = __rp;
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "incremental.h"
+
+typedef struct tree {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+    int serial;                 // 分配序号，单元被回收之后会变化
+    int left_serial;            // 引用的对象的分配序号
+    int right_serial;
+    struct tree *left;
+    struct tree *right;
+} tree;
+
+class_descriptor tree_object_class = {
+    "tree_object",
+    sizeof(struct tree),
+    2,
+    (int[]) {
+        offsetof(struct tree, left),
+        offsetof(struct tree, right)
+    }
+};
+
+int next_serial;
+
+tree* new_tree() {
+    tree* t = (tree *) gc_alloc(&tree_object_class);
+    t->serial = ++next_serial;
+    t->left_serial = 0;
+    t->right_serial = 0;
+
+    return t;
+}
+
+// 通过写入屏障修改引用，同时记录引用的对象的分配序号
+void set_left(tree* p, tree* child) {
+    gc_update_ptr((object *) p, (object **) &p->left, (object *) child);
+    p->left_serial = child ? child->serial : 0;
+}
+
+void set_right(tree* p, tree* child) {
+    gc_update_ptr((object *) p, (object **) &p->right, (object *) child);
+    p->right_serial = child ? child->serial : 0;
+}
+
+// 从随机的GC ROOTS开始随机向下走几步
+tree* random_tree() {
+    tree* t = (tree *) _roots[rand() % _rp];
+    for (int depth = rand() % 6; depth > 0; --depth) {
+        tree* child = rand() % 2 ? t->left : t->right;
+        if (!child) {
+            break;
+        }
+        t = child;
+    }
+
+    return t;
+}
+
+// 检查引用的对象是否还是原来的对象，被错误回收的对象会被清零或者被重新分配
+// 沿着left循环，只对right递归，大堆上很长的链表也不会栈溢出
+void check_tree(tree* t, int serial, byte* visited) {
+    while (t) {
+        if (t->clss != &tree_object_class || t->serial != serial) {
+            printf("live object is reclaimed!\n");
+            abort();
+        }
+
+        int index = ((void *) t - heap_start) / NODE_SIZE;
+        if (visited[index]) {
+            return;
+        }
+        visited[index] = TRUE;
+
+        check_tree(t->right, t->right_serial, visited);
+        serial = t->left_serial;
+        t = t->left;
+    }
+}
+
+void check_roots() {
+    byte* visited = (byte *) calloc(num_nodes, 1);
+    for (int i = 0; i < _rp; ++i) {
+        check_tree((tree *) _roots[i], ((tree *) _roots[i])->serial, visited);
+    }
+    free(visited);
+}
+
+// 测试写入屏障：在增量GC的过程中随机修改引用，活动对象不能被回收
+void test_barrier(barrier_type barrier) {
+    printf("test_barrier %d\n", barrier);
+    gc_set_barrier(barrier);
+    gc_init(4096 * NODE_SIZE);
+    srand(barrier + 1);
+    next_serial = 0;
+
+    for (int i = 0; i < 8; ++i) {
+        gc_add_root(new_tree());
+    }
+
+    for (int i = 0; i < 300000; ++i) {
+        tree* p = random_tree();
+        tree* q = random_tree();
+
+        switch (rand() % 6) {
+            case 0:
+            case 1: {
+                // 增量GC只在分配时执行，p可以从GC ROOTS到达，不会被回收
+                tree* t = new_tree();
+                rand() % 2 ? set_left(p, t) : set_right(p, t);
+                break;
+            }
+            case 2: {
+                // 交换两个对象的子对象，交换过程中t只被局部变量引用
+                tree* t = q->left;
+                set_left(q, p->right);
+                set_right(p, t);
+                break;
+            }
+            case 3:
+                rand() % 2 ? set_left(p, NULL) : set_right(p, NULL);
+                break;
+            case 4:
+                // 修改GC ROOTS不经过写入屏障
+                _roots[rand() % _rp] = (object *) q;
+                break;
+            case 5:
+                set_left(p, q);
+                break;
+        }
+
+        if (i % 100 == 0) {
+            check_roots();
+        }
+    }
+    check_roots();
+
+    if (collections < 10) {
+        printf("only %d collections!\n", collections);
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 单元测试中最大暂停时间的上限(ns)，远小于64MB的堆上一次性完成一轮GC的时间(约30ms)，给调度和调试版本留出余量
+#define MAX_PAUSE_BOUND 10000000L
+
+// 1/4的单元是活动对象，之后分配大量短命的对象，偶尔替换活动对象，返回最大暂停时间(ns)
+long pause_workload(int size) {
+    gc_set_barrier(BARRIER_DIJKSTRA);
+    gc_init(size);
+    next_serial = 0;
+
+    for (int i = 0; i < 8; ++i) {
+        gc_add_root(new_tree());
+    }
+    for (int i = 0; i < num_nodes / 4; ++i) {
+        tree* root = (tree *) _roots[i % 8];
+        tree* t = new_tree();
+        set_left(t, root->left);
+        set_left(root, t);
+    }
+
+    for (int i = 0; i < 3 * num_nodes; ++i) {
+        tree* t = new_tree();
+        if (i % 16 == 0) {
+            tree* root = (tree *) _roots[i % 8];
+            set_left(t, root->left ? root->left->left : NULL);
+            set_left(root, t);
+        }
+    }
+    check_roots();
+
+    gc_get_state();
+    if (collections < 2 || full_collections > 0) {
+        printf("incremental gc does not keep up with allocation!\n");
+        abort();
+    }
+
+    long pause = max_pause;
+    gc_done();
+
+    return pause;
+}
+
+// 测试最大暂停时间：增量GC跟得上分配，堆变大之后每一步的暂停时间也不会变长
+void test_max_pause() {
+    printf("test_max_pause\n");
+
+    int sizes[2] = { 4, 64 };
+    for (int i = 0; i < 2; ++i) {
+        long pause = pause_workload(sizes[i] * 1024 * 1024);
+        printf("max pause: %dMB = %ld ns\n", sizes[i], pause);
+        if (pause > MAX_PAUSE_BOUND) {
+            printf("max pause is too long!\n");
+            abort();
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // 在更大的堆上测量最大暂停时间，例如make pause在1GB的堆上测量，目标是1ms以内
+    if (argc > 2 && strcmp(argv[1], "pause") == 0) {
+        int size = atoi(argv[2]);
+        printf("%dMB max pause = %ld ns\n", size, pause_workload(size * 1024 * 1024));
+        return 0;
+    }
+
+
+    test_barrier(BARRIER_DIJKSTRA);
+    test_barrier(BARRIER_STEELE);
+    test_barrier(BARRIER_YUASA);
+    test_max_pause();
+
+    return 0;
+}
@@ -1,12 +1,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "copying.h"
 
 object* _roots[MAX_ROOTS];
 
 int _rp;
-void *heap;                 // 堆指针
 void *from;                 // from指针
 void *to;                   // to指针
 int next_forwarding_offset; // 复制目标区域的free pointer
@@ -15,6 +16,10 @@ object* _roots[MAX_ROOTS];
 int next_free_offset;       // 下一个空闲内存地址（相对位置）
 int heap_size;              // 堆容量
 int heap_half_size;         // 堆容量
+int space_map_size;         // 每个半区实际mmap的大小
+
+space_release release_mode = SPACE_RELEASE_NONE;  // 原空间物理页的释放方式
+byte use_huge_page = FALSE;                         // 是否申请透明大页
 
 
 /**
@@ -54,6 +59,21 @@ void swap(void** src,void** dst);
  */
 int resolve_heap_size(int size);
 
+/**
+ * @brief 为一个半区申请独立的mmap区域
+ * 
+ * @param size 半区大小
+ * @return void* 半区起始地址
+ */
+void* map_space(int size);
+
+/**
+ * @brief 释放原空间的物理页，虚拟地址保留，下次作为to使用时由内核重新分配清零的页
+ * 
+ * @param space 半区起始地址
+ */
+void release_space(void* space);
+
 void swap(void** src, void** dst) {
     object* temp = *src;
     *src = *dst;
@@ -68,12 +88,91 @@ int resolve_heap_size(int size) {
     return size / 2 * 2;
 }
 
+void gc_set_space_options(space_release release, byte huge_page) {
+    release_mode = release;
+    use_huge_page = huge_page;
+}
+
+void* map_space(int size) {
+    if (!use_huge_page) {
+        void* space = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return space == MAP_FAILED ? NULL : space;
+    }
+
+    // 透明大页要求2MB对齐，多申请一个大页，再把首尾不对齐的部分还回去
+    void* raw = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    unsigned long addr = (unsigned long) raw;
+    unsigned long aligned = (addr + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > addr) {
+        munmap(raw, aligned - addr);
+    }
+    munmap((void *) (aligned + size), addr + HUGE_PAGE_SIZE - aligned);
+
+#ifdef MADV_HUGEPAGE
+    madvise((void *) aligned, size, MADV_HUGEPAGE);
+#endif
+    return (void *) aligned;
+}
+
+void release_space(void* space) {
+    if (release_mode == SPACE_RELEASE_NONE) {
+        return;
+    }
+
+#ifdef MADV_FREE
+    if (release_mode == SPACE_RELEASE_FREE && madvise(space, space_map_size, MADV_FREE) == 0) {
+        return;
+    }
+#endif
+    madvise(space, space_map_size, MADV_DONTNEED);
+}
+
+int resident_size(void* space) {
+    int page_size = getpagesize();
+    int pages = space_map_size / page_size;
+    unsigned char vec[pages];
+    int resident = 0;
+
+    if (mincore(space, space_map_size, vec) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < pages; ++i) {
+        if (vec[i] & 1) {
+            resident += page_size;
+        }
+    }
+    return resident;
+}
+
 void gc_init(int size) {
     heap_size = resolve_heap_size(size);
     heap_half_size = heap_size / 2;
-    heap = (void *) malloc(heap_size);
-    from = heap;
-    to = (void *) (heap_half_size + from);
+
+    // 两个半区各自mmap，互不相邻，这样才能单独归还原空间的物理页
+    int page_size = use_huge_page ? HUGE_PAGE_SIZE : getpagesize();
+    space_map_size = (heap_half_size + page_size - 1) / page_size * page_size;
+
+    from = map_space(space_map_size);
+    to = map_space(space_map_size);
+    if (!from || !to) {
+        printf("Heap initialization failed! mmap...\n");
+        abort();
+    }
+
+    next_free_offset = 0;
+    _rp = 0;
+}
+
+void gc_done() {
+    munmap(from, space_map_size);
+    munmap(to, space_map_size);
+    from = to = NULL;
+    next_free_offset = 0;
     _rp = 0;
 }
 
@@ -95,7 +194,7 @@ object* gc_alloc(class_descriptor* clss) {
     next_free_offset = next_free_offset + clss->size;
 
     // 分配
-    object* new_obj = (object *) (old_offset + heap);
+    object* new_obj = (object *) (old_offset + from);
 
     // 初始化
     new_obj->clss = clss;
@@ -155,7 +254,11 @@ void copying() {
     // 更新引用
     adjust_ref();
 
-    // 清空from，并交换from/to
+    // 复制结束后，to中的对象是紧凑的，分配从其末尾继续
+    next_free_offset = next_forwarding_offset;
+
+    // 原空间只剩垃圾，把物理页归还，交换from/to
+    release_space(from);
     swap(&from, &to);
 }
 
@@ -181,3 +284,20 @@ void gc() {
     printf("gc...\n");
     copying();
 }
+
+char* gc_get_state() {
+    printf("Heap Usage:\n");
+    printf("From Space:\n");
+    printf("   capacity = %d\n", heap_half_size);
+    printf("   used     = %d\n", next_free_offset);
+    printf("   resident = %d\n", resident_size(from));
+    printf("To Space:\n");
+    printf("   capacity = %d\n", heap_half_size);
+    printf("   resident = %d\n", resident_size(to));
+
+    return NULL;
+}
+
+int gc_num_roots() {
+    return _rp;
+}
@@ -31,6 +31,20 @@ struct _object {
 
 #define MAX_HEAP_SIZE 1024 * 1024 * 10 // 10MB
 
+#define HUGE_PAGE_SIZE (1024 * 1024 * 2) // 透明大页的大小，2MB
+
+/**
+ * @brief GC结束后，释放原空间（from）物理页的方式
+ *  1. 两个半区分别是独立的mmap区域，复制结束后原空间里只剩垃圾，可以把物理页还给内核
+ *  2. 这样常驻内存就只有一个半区的大小
+ * 
+ */
+typedef enum {
+    SPACE_RELEASE_NONE,     // 不释放，保持原来的行为
+    SPACE_RELEASE_DONTNEED, // MADV_DONTNEED，立即归还物理页，再次访问时得到清零的新页
+    SPACE_RELEASE_FREE      // MADV_FREE，内核在内存紧张时才回收，开销更小；不支持时退化为MADV_DONTNEED
+} space_release;
+
 const static byte TRUE = 1;
 const static byte FALSE = 0;
 
@@ -43,6 +57,20 @@ extern int _rp;
 // 堆总大小
 extern int heap_size;
 
+// 当前分配的半区
+extern void *from;
+
+// 复制的目标半区，GC结束后是原空间
+extern void *to;
+
+/**
+ * @brief 统计半区中常驻物理内存的大小
+ * 
+ * @param space 半区起始地址
+ * @return int 常驻字节数
+ */
+extern int resident_size(void *space);
+
 /**
  * @brief 初始化GC
  * 
@@ -50,6 +78,14 @@ extern int heap_size;
  */
 extern void gc_init(int size);
 
+/**
+ * @brief 设置半区的内存选项，需要在gc_init之前调用
+ * 
+ * @param release 每次GC后释放原空间物理页的方式
+ * @param huge_page 是否为半区申请透明大页(THP)，减少复制时的TLB miss
+ */
+extern void gc_set_space_options(space_release release, byte huge_page);
+
 /**
  * @brief 执行GC
  * 
@@ -36,7 +36,8 @@ class_descriptor dept_object_class = {
     NULL
 };
 
-int main(int argc, char *argv[]) {
+// 测试复制回收，第3轮循环时内存溢出
+void test_copying() {
     gc_init((emp_object_class.size + dept_object_class.size) * 3 * 2);
 
     for (int i = 0; i < 4; ++i) {
@@ -53,4 +54,49 @@ int main(int argc, char *argv[]) {
         dept *_dept2 = (dept *) gc_alloc(&dept_object_class);
         _emp2->dept = _dept2;
     }
+}
+
+// 分配大量垃圾，最后再GC一次，返回原空间中常驻物理内存的大小
+int space_release_workload(space_release release) {
+    gc_set_space_options(release, FALSE);
+    gc_init(1024 * 1024 * 4);
+
+    emp *_emp1 = (emp *) gc_alloc(&emp_object_class);
+    gc_add_root(_emp1);
+
+    // 分配大量垃圾，触发多次GC
+    for (int i = 0; i < 1024 * 1024 / 8; ++i) {
+        gc_alloc(&dept_object_class);
+    }
+
+    // GC之后to就是原空间，其中的对象刚刚被复制走
+    gc();
+    int resident = resident_size(to);
+
+    gc_get_state();
+    gc_done();
+    gc_set_space_options(SPACE_RELEASE_NONE, FALSE);
+
+    return resident;
+}
+
+// 测试GC后归还原空间的物理页，常驻内存应该只有一个半区
+void test_space_release() {
+    int released = space_release_workload(SPACE_RELEASE_DONTNEED);
+    int kept = space_release_workload(SPACE_RELEASE_NONE);
+
+    printf("from space resident: release = %d, keep = %d\n", released, kept);
+    if (released != 0) {
+        printf("from space is not released!\n");
+        abort();
+    }
+    if (kept < 1024 * 1024) {
+        printf("from space is released without SPACE_RELEASE_DONTNEED!\n");
+        abort();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    test_space_release();
+    test_copying();
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
 #include "generational.h"
 
 object* _roots[MAX_ROOTS];
@@ -26,31 +28,167 @@ int old_size;               // 老年代容量
 int eden_size;              // eden区容量
 int survivor_size;          // survivor区容量
 
+byte gc_adaptive_sizing = FALSE;    // 是否自适应调整晋升年龄和eden/survivor的大小
+int tenuring_threshold = MAX_AGE;   // 晋升年龄
+int age_table[MAX_AGE + 1];         // 本次GC后留在幸存空间中的对象，按年龄统计的大小
+int overflow_bytes;                 // 本次GC中因为幸存空间放不下而提前晋升的对象大小
+int avg_survived;                   // 每次GC中存活的新生代对象（不含到达晋升年龄的对象）大小的平均值
+
+byte gc_pretenuring = FALSE;                // 是否根据每个类的存活率直接在老年代中分配
+int pretenure_size = 0;                     // 不小于该大小的对象直接在老年代中分配，0表示不限制
+class_descriptor* sampled_classes[MAX_CLASSES]; // 上次新生代GC之后在eden中分配过对象的类
+int num_sampled_classes;
+
 object* _roots[MAX_ROOTS];
 
-node* old_next_free;    // 老年代下一个空闲单元
-node* old_head;         // 老年代free-list的头节点
+node* old_head;         // 老年代free-list的头节点，只链接空闲单元
+int old_free_nodes;     // 老年代free-list中的空闲单元数
+
+object** promoted;      // 本次新生代GC中晋升的对象，和to空间中的对象一样是灰色对象
+int promoted_count;     // 晋升的对象数
+int promoted_capacity;  // 晋升列表的容量
+
+rs_mode gc_rs_mode = RS_OBJECT; // 记录老年代到新生代引用的方法
+byte* card_table;               // 卡片表格
+int num_cards;                  // 卡片数
+
+__thread ssb_buffer* ssb;               // 当前线程的顺序存储缓冲区
+ssb_buffer* ssb_buffers[MAX_THREADS];   // 所有线程的顺序存储缓冲区
+int num_ssb_buffers;
+pthread_mutex_t ssb_lock = PTHREAD_MUTEX_INITIALIZER;   // 保护ssb_buffers，线程注册、退出和GC倒空缓冲区时使用
+pthread_key_t ssb_key;                                  // 线程退出时通过它的析构函数注销缓冲区
+pthread_once_t ssb_key_once = PTHREAD_ONCE_INIT;
+
+old_collector* old_gen = &mark_sweep_collector;   // 老年代收集器
+object** mark_stack;    // 老年代GC标记时的灰色对象
+int mark_sp;
+int mark_stack_capacity;
+void* old_top;          // 老年代顺序分配的位置，之前的对象连续排列
+void* plab_top;         // 当前PLAB的下一个空闲位置
+void* plab_end;         // 当前PLAB的结束位置
+int* card_first;        // 每张卡片中第一个对象的地址（相对堆的偏移），没有对象为-1
+
+// 填充PLAB剩余空间的对象，只有clss一个字，不会被引用
+class_descriptor filler_class = {
+    "filler",
+    sizeof(class_descriptor *),
+    0,
+    NULL
+};
+
+int parallel_workers = 1;           // 并行新生代GC的线程数
+gc_worker workers[MAX_WORKERS];     // 并行新生代GC的线程
+int idle_workers;                   // 找不到灰色对象的线程数，等于线程数时结束
+int next_root;                      // 下一个要领取的GC ROOT
+object** old_tasks;                 // 需要搜索的老年代对象（记录集/卡片的快照）
+int num_old_tasks;
+int old_tasks_capacity;
+int next_old_task;                  // 下一个要领取的老年代对象
+object*** slot_tasks;               // 需要搜索的域（slot记录集的快照）
+int num_slot_tasks;
+int next_slot_task;                 // 下一个要领取的域
+pthread_mutex_t old_lock = PTHREAD_MUTEX_INITIALIZER;       // 老年代分配的锁
+pthread_mutex_t remember_lock = PTHREAD_MUTEX_INITIALIZER;  // 记录集的锁
+
+object*** slot_set;     // 指向新生代的老年代域的记录集，开放寻址的哈希集合
+int slot_set_capacity;  // 哈希集合容量，2的幂
+int slot_set_count;     // 记录的域数量
 
 void new_copying();     //  新生代复制
 
 object* new_copy(object* obj);      // 新生代复制对象
 
-void adjust_ref();                  // 复制后更新引用
 int resolve_heap_size(int size);
 void swap(void** src,void** dst);   // 指针交换
 void minor_gc();                    // 新生代gc
+void serial_minor_gc();             // 单线程的新生代gc
 void major_gc();                    // 老年代gc
 void promotion(object* obj);        // 对象晋升
 
 object* new_malloc(class_descriptor* class);    // 新生代分配
 object* old_malloc(object* obj);                // 老年代分配
 node* old_init_free_list(int free_list_size);   // 老年代free-list分配
-node* old_find_idle_node();                     // 老年代free-list查找空闲单元
-
-void old_mark(object* obj); // 老年代标记
+object* pretenure_malloc(class_descriptor* clss);   // 直接在老年代中分配
+void sample_allocation(class_descriptor* clss);     // 统计在eden中分配的对象数
+void update_pretenuring();                          // 根据新生代GC的结果决定哪些类直接在老年代中分配
+byte is_eden(object* obj);                          // 是否是eden中的对象
+byte stays_young(object* obj);                      // 复制时是否留在幸存空间中
+
+void major_mark();          // 从所有GC ROOTS出发，经过新生代对象标记
+void mark_push(object* obj);
+void clear_young_marks();   // 清除新生代对象的标记
 void old_sweep();           // 老年代清除
 void write_barrier(object* obj, object** field_ref, object* new_obj); // 写入屏障
 
+byte is_young(object* obj);             // 是否是新生代对象
+void remember(object* obj);             // 记录引用了新生代对象的老年代对象
+void scan_remembered_set();             // 新生代GC时搜索记录集
+void scan_dirty_cards();                // 新生代GC时搜索卡片表格
+byte scan_object(object* obj);          // 复制对象引用的新生代对象并更新域，返回是否还引用着新生代对象
+void scavenge();                        // 广度优先地搜索to空间和晋升的对象
+
+ssb_buffer* ssb_register();             // 为当前线程分配顺序存储缓冲区
+void ssb_unregister(void* buffer);      // 线程退出时倒空并注销它的缓冲区
+void ssb_flush(ssb_buffer* buffer);     // 把缓冲区中的域去重后加入记录集
+void ssb_flush_all();                   // 倒空所有线程的缓冲区
+byte is_old_slot(object** slot);        // 域是否位于一个使用中的老年代对象中
+void slot_set_add(object** slot);       // 加入slot记录集，已经记录的域不会重复加入
+void slot_set_rebuild(byte scavenge);   // 重建slot记录集，scavenge为TRUE时复制域引用的新生代对象
+void scan_slot_set();                   // 新生代GC时搜索slot记录集
+
+void* old_bump(int size);               // 在老年代顺序分配
+object* plab_malloc(int size);          // 在PLAB中分配晋升对象
+void plab_retire();                     // 结束当前PLAB，填充剩余空间
+void record_object_start(void* addr);   // 记录卡片中第一个对象的位置
+void ensure_promotion_space();          // 保证新生代GC时老年代能容纳所有晋升对象
+void old_compact();                     // 老年代压缩
+void rebuild_remembered();              // 老年代压缩之后重新建立记录集
+
+void visit_card(int card, void (*visitor)(object* obj, int card));    // 遍历对象头位于卡片中的所有对象
+void scan_card_object(object* obj, int card);   // 搜索卡片中的对象，还引用着新生代对象时设置卡片的标志位
+void add_old_task(object* obj, int card);       // 把老年代对象加入并行搜索的快照
+
+void parallel_minor_gc();                       // 并行新生代GC
+void* parallel_scavenge(void* arg);             // 并行新生代GC的线程
+object* par_copy(gc_worker* w, object* obj);    // 复制对象，用CAS设置forwarding指针
+byte par_scan(gc_worker* w, object* obj);       // 复制对象引用的新生代对象并更新域
+void* survivor_lab_alloc(gc_worker* w, int size);       // 在线程本地的幸存空间缓冲区中分配
+object* par_old_malloc(gc_worker* w, object* obj);      // 在线程本地的PLAB中晋升
+void par_undo(gc_worker* w, object* copy);              // 撤销没有抢到forwarding指针的复制
+
+void ms_init();
+object* ms_alloc(gc_worker* w, int size);
+void ms_undo(gc_worker* w, object* obj);
+void ms_retire(gc_worker* w);
+int ms_promotable_bytes();
+void ms_reclaim();
+int ms_used_bytes();
+void ms_visit_card(int card, void (*visitor)(object* obj, int card));
+byte ms_contains_slot(object** slot);
+int ms_max_object_size();
+
+void mc_init();
+object* mc_alloc(gc_worker* w, int size);
+void mc_undo(gc_worker* w, object* obj);
+void mc_retire(gc_worker* w);
+int mc_promotable_bytes();
+void mc_reclaim();
+int mc_used_bytes();
+void mc_visit_card(int card, void (*visitor)(object* obj, int card));
+byte mc_contains_slot(object** slot);
+int mc_max_object_size();
+
+void fill(void* start, void* end);                      // 用filler填充空间
+void worker_push(gc_worker* w, object* obj);
+object* worker_pop(gc_worker* w);
+object* worker_steal(gc_worker* w);             // 从其他线程的队列中窃取，所有线程都找不到时返回NULL
+int claim(int* next);                           // 领取下一个任务
+
+void compute_tenuring_threshold();              // 根据年龄分布计算晋升年龄
+void resize_young();                            // 根据存活的大小调整eden和survivor的大小
+void move_survivors(void* target);              // 移动幸存空间中的对象，并更新引用它们的指针
+void move_pointer(object** field, void* start, void* end, long delta);
+
 /**
  * @brief 老年代free-list分配
  *  1. 老年区按NODE_SIZE 划分节点，节点之间构建链表
@@ -72,29 +210,6 @@ node* old_init_free_list(int free_list_size) {
     return head;
 }
 
-/**
- * @brief 老年代free-list查找空闲单元
- * 
- * @return node* 
- */
-node* old_find_idle_node() {
-    for (old_next_free = old_head; old_next_free && old_next_free->used; old_next_free = old_next_free->next) {}
-
-    // 还找不到就触发回收
-    if (!old_next_free) {
-        printf("[Old]Allocation Failed. execute gc...\n");
-        major_gc();
-    }
-
-    for (old_next_free = old_head; old_next_free && old_next_free->used; old_next_free = old_next_free->next) {}
-
-    // 真的找不到
-    if (!old_next_free) {
-        printf("[Old]Allocation Failed!OutOfMemory...\n");
-        abort();
-    }
-}
-
 /**
  * @brief 堆数据分配
  *  1. 新生代空间：幸存空间 + 生成空间 
@@ -152,14 +267,68 @@ void gc_init(int size) {
     old = new_size + heap;
 
     // 初始化老年代资源
-    int free_list_size = old_size / NODE_SIZE;
+    old_gen->init();
+
+    // 卡片表格覆盖整个堆
+    num_cards = (heap_size + CARD_SIZE - 1) / CARD_SIZE;
+    card_table = (byte *) calloc(num_cards, 1);
+    card_first = (int *) malloc(num_cards * sizeof(int));
+    memset(card_first, -1, num_cards * sizeof(int));
+
+    // slot记录集
+    free(slot_set);
+    slot_set_capacity = SSB_SIZE;
+    slot_set = (object ***) calloc(slot_set_capacity, sizeof(object **));
+    slot_set_count = 0;
+    for (int i = 0; i < num_ssb_buffers; ++i) {
+        ssb_buffers[i]->top = 0;
+    }
 
-    // 返回第一个老年区节点
-    old_head = old_init_free_list(free_list_size);
+    next_free_offset = 0;
+    next_forwarding_offset = 0;
+    _rp = 0;
+    _rsp = 0;
 
-    old_next_free = old_head;
+    tenuring_threshold = MAX_AGE;
+    avg_survived = 0;
+    num_sampled_classes = 0;
+}
 
-    _rp = 0;
+void gc_set_rs_mode(rs_mode mode) {
+    gc_rs_mode = mode;
+}
+
+void gc_set_promotion_mode(promotion_mode mode) {
+    old_gen = mode == PROMOTE_BUMP ? &mark_compact_collector : &mark_sweep_collector;
+}
+
+void gc_set_old_collector(old_collector* collector) {
+    old_gen = collector;
+}
+
+void gc_set_parallel_workers(int n) {
+    parallel_workers = n < 1 ? 1 : (n > MAX_WORKERS ? MAX_WORKERS : n);
+}
+
+void gc_set_adaptive_sizing(byte enable) {
+    gc_adaptive_sizing = enable;
+}
+
+void gc_set_pretenuring(byte enable) {
+    gc_pretenuring = enable;
+}
+
+void gc_set_pretenure_size(int size) {
+    pretenure_size = size;
+}
+
+/**
+ * @brief 是否是新生代对象
+ *  1. 新生代(eden + 两个幸存空间)位于堆的开头，老年代之前的都是新生代
+ * 
+ */
+byte is_young(object* obj) {
+    return obj && (void *) obj < old;
 }
 
 /**
@@ -169,6 +338,12 @@ void gc_init(int size) {
  * @return object* 
  */
 object* new_malloc(class_descriptor* clss) {
+    // 大对象和几乎总是存活的类直接在老年代中分配，老年代收集器容纳不下的对象还是在eden中分配
+    if (((pretenure_size && clss->size >= pretenure_size) || (gc_pretenuring && clss->pretenured))
+        && clss->size <= old_gen->max_object_size()) {
+        return pretenure_malloc(clss);
+    }
+
     // 检查是否可以分配
     if (next_free_offset + clss->size > eden_size) {
         printf("[New]Allocation Failed. execute gc...\n");
@@ -200,9 +375,96 @@ object* new_malloc(class_descriptor* clss) {
         *(object **) ((void *) new_obj + new_obj->clss->field_offsets[i]) = NULL;
     }
 
+    if (gc_pretenuring) {
+        sample_allocation(clss);
+    }
+
+    return new_obj;
+}
+
+/**
+ * @brief 直接在老年代中分配
+ *  1. 不在新生代GC中，老年代放不下时可以直接进行老年代GC
+ * 
+ * @param clss 
+ * @return object* 
+ */
+object* pretenure_malloc(class_descriptor* clss) {
+    if (old_gen->promotable_bytes() < clss->size) {
+        printf("[Old]Allocation Failed. execute gc...\n");
+        major_gc();
+    }
+
+    object* new_obj = old_gen->alloc(NULL, clss->size);
+
+    new_obj->clss = clss;
+    new_obj->forwarded = FALSE;
+    new_obj->marked = FALSE;
+    new_obj->remembered = FALSE;
+    new_obj->age = 0;
+    new_obj->forwarding = NULL;
+
+    for (int i = 0; i < clss->num_fields; ++i) {
+        *(object **) ((void *) new_obj + clss->field_offsets[i]) = NULL;
+    }
+
     return new_obj;
 }
 
+/**
+ * @brief 统计在eden中分配的对象数
+ *  1. 类第一次在这个GC周期中分配对象时登记，新生代GC结束后统一计算存活率
+ * 
+ * @param clss 
+ */
+void sample_allocation(class_descriptor* clss) {
+    if (clss->allocated == 0) {
+        if (num_sampled_classes == MAX_CLASSES) {
+            return;
+        }
+        sampled_classes[num_sampled_classes++] = clss;
+    }
+
+    clss->allocated++;
+}
+
+/**
+ * @brief 根据新生代GC的结果决定哪些类直接在老年代中分配
+ *  1. eden中的对象这次都经历了第一次新生代GC，复制或晋升时已经统计在survived中
+ *  2. 采样足够多、存活率达到PRETENURE_SURVIVAL_RATIO的类，之后直接在老年代中分配
+ * 
+ */
+void update_pretenuring() {
+    for (int i = 0; i < num_sampled_classes; ++i) {
+        class_descriptor* clss = sampled_classes[i];
+        clss->sampled += clss->allocated;
+        clss->allocated = 0;
+
+        if (!clss->pretenured && clss->sampled >= PRETENURE_MIN_SAMPLES && clss->survived * 100 >= clss->sampled * PRETENURE_SURVIVAL_RATIO) {
+            printf("[Pretenure]%s survived %d/%d\n", clss->name, clss->survived, clss->sampled);
+            clss->pretenured = TRUE;
+        }
+    }
+
+    num_sampled_classes = 0;
+}
+
+byte is_eden(object* obj) {
+    return (void *) obj >= new_eden && (void *) obj < new_eden + eden_size;
+}
+
+/**
+ * @brief 复制时是否留在幸存空间中
+ *  1. 没有达到晋升年龄的对象
+ *  2. 老年代收集器容纳不下的对象，达到晋升年龄之后也继续在幸存空间之间复制
+ * 
+ * @param obj 
+ * @return byte 
+ */
+byte stays_young(object* obj) {
+    return obj->age < tenuring_threshold || obj->clss->size > old_gen->max_object_size();
+}
+
 /**
  * @brief 老年代内存分配
  * 
@@ -210,38 +472,110 @@ object* new_malloc(class_descriptor* clss) {
  * @return object* 返回老年代中的新内存
  */
 object* old_malloc(object* obj) {
-    // 如果内存不够，就开始老年代GC
-    if (!old_next_free || old_next_free->used) {
-        old_find_idle_node();
-    }
-
-    class_descriptor* clss = obj->clss;
-    // 赋值当前freePoint
-    node* _node = old_next_free;
-
-    // 新分配的对象指针
-    // 将新对象分配在free-list的节点数据之后，node单元的空间除了sizeof(node), 剩下的地址空间都用于存储对象
-    object* new_obj = (void*) _node + sizeof(node);
+    object* new_obj = old_gen->alloc(NULL, obj->clss->size);
 
     // 复制
     memcpy(new_obj, obj, obj->clss->size);
 
     new_obj->forwarded = FALSE;
     new_obj->marked = FALSE;
+    new_obj->remembered = FALSE;
+    new_obj->forwarding = NULL;
 
-    _node->used = TRUE;
-    _node->data = new_obj;
-    _node->size = clss->size;
+    return new_obj;
+}
 
-    for (int i = 0; i < new_obj->clss->num_fields; ++i) {
-        // *(data **)是一个dereference操作，拿到field的pointer
-        // (void *)o是强转为void* pointer，void*进行加法运算的时候就不会按类型增加地址
-        *(object **) ((void *) new_obj + new_obj->clss->field_offsets[i]) = NULL;
+/**
+ * @brief 在老年代顺序分配
+ *  1. 新生代GC之前已经保证了老年代有足够的空间，这里分配失败说明老年代GC之后也放不下
+ * 
+ * @param size 
+ * @return void* 
+ */
+void* old_bump(int size) {
+    if (old_top + size > old + old_size) {
+        printf("[Old]Promotion Failed! OutOfMemory...\n");
+        abort();
     }
 
-    old_next_free = old_next_free->next;
+    void* addr = old_top;
+    old_top += size;
 
-    return new_obj;
+    return addr;
+}
+
+/**
+ * @brief 在PLAB中分配晋升对象
+ *  1. 晋升只需要移动PLAB的指针，晋升的对象在老年代中连续排列
+ *  2. PLAB用完时才从老年代中切出新的PLAB，超过PLAB一半大小的对象直接在老年代中分配
+ * 
+ * @param size 
+ * @return object* 
+ */
+object* plab_malloc(int size) {
+    void* addr;
+
+    if (plab_top && plab_top + size <= plab_end) {
+        addr = plab_top;
+        plab_top += size;
+    } else if (size > PLAB_SIZE / 2) {
+        addr = old_bump(size);
+    } else {
+        plab_retire();
+
+        int plab_size = old + old_size - old_top < PLAB_SIZE ? old + old_size - old_top : PLAB_SIZE;
+        plab_top = old_bump(plab_size < size ? size : plab_size);
+        plab_end = old_top;
+
+        addr = plab_top;
+        plab_top += size;
+    }
+
+    record_object_start(addr);
+
+    return (object *) addr;
+}
+
+/**
+ * @brief 结束当前PLAB
+ *  1. PLAB位于老年代末尾时，直接把剩余空间还给老年代
+ *  2. 否则用filler填充剩余空间，保证老年代可以从头到尾逐个对象地遍历
+ * 
+ */
+void plab_retire() {
+    if (!plab_top) {
+        return;
+    }
+
+    if (plab_end == old_top) {
+        old_top = plab_top;
+    } else {
+        for (void* p = plab_top; p < plab_end; p += filler_class.size) {
+            ((object *) p)->clss = &filler_class;
+        }
+    }
+
+    plab_top = NULL;
+    plab_end = NULL;
+}
+
+/**
+ * @brief 记录卡片中第一个对象的位置
+ *  1. 搜索卡片时从这个对象开始遍历，不需要从老年代开头找起
+ * 
+ * @param addr 
+ */
+void record_object_start(void* addr) {
+    int offset = addr - heap;
+    int card = offset / CARD_SIZE;
+
+    // 并行新生代GC时，多个线程的PLAB可能在同一张卡片中
+    int first = __atomic_load_n(&card_first[card], __ATOMIC_RELAXED);
+    while (first < 0 || offset < first) {
+        if (__atomic_compare_exchange_n(&card_first[card], &first, offset, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
 }
 
 /**
@@ -265,18 +599,30 @@ object* gc_alloc(class_descriptor* clss) {
 object* new_copy(object* obj) {
     if (!obj) { return NULL; }
 
+    // 已经在to空间中的对象不需要再复制
+    if ((void *) obj >= new_to && (void *) obj < new_to + survivor_size) { return obj; }
+
     // 由于一个对象可能被多个对象引用，所以此处判断，避免重复复制
     if (!obj->forwarded) {
+        if (gc_pretenuring && is_eden(obj)) {
+            obj->clss->survived++;
+        }
+
         // 新生代
-        if (obj->age < MAX_AGE) {
-            // 计算复制后的指针
-            if (next_free_offset + obj->clss->size > survivor_size) {
-                printf("[New]Copy failed! Insufficient TO space\n");
-                abort();
+        if (stays_young(obj)) {
+            // 计算复制后的指针，幸存空间放不下时提前晋升
+            if (next_forwarding_offset + obj->clss->size > survivor_size) {
+                printf("[New]Insufficient TO space, premature promotion...\n");
+                overflow_bytes += obj->clss->size;
+                promotion(obj);
+                return obj->forwarding;
             }
 
-            // 增加年龄
-            obj->age++;
+            // 增加年龄，留在幸存空间中的大对象不超过MAX_AGE
+            if (obj->age < MAX_AGE) {
+                obj->age++;
+            }
+            age_table[obj->age] += obj->clss->size;
 
             // 将幸存空间做为目标空间，进行复制
             object* forwarding = (object* )(next_forwarding_offset + new_to);
@@ -290,16 +636,11 @@ object* new_copy(object* obj) {
 
             obj->forwarded = TRUE;
 
-            // 将复制后的指针，写入原对象的forwarding pointer,为最后更新引用做准备
+            // 将复制后的指针，写入原对象的forwarding pointer，引用它的域搜索时会更新为这个指针
             obj->forwarding = forwarding;
 
-            // 复制后，移动to区forwarding偏移
+            // 复制后，移动to区forwarding偏移，复制的对象引用的对象由scavenge()搜索
             next_forwarding_offset += obj->clss->size;
-
-            // 递归复制引用对象，递归是深度优先
-            for (int i = 0; i < obj->clss->num_fields; ++i) {
-                new_copy(*(object **) ((void *) obj + obj->clss->field_offsets[i]));
-            }
         } else {
             // 超过年龄就晋升
             promotion(obj);
@@ -315,28 +656,6 @@ void swap(void** src, void** dst) {
     *dst = temp;
 }
 
-/**
- * @brief 复制后更新引用
- * 
- */
-void adjust_ref() {
-    int p = 0;
-    // 遍历to，即复制的目标空间
-    while (p < next_forwarding_offset) {
-        object* obj = (object *) (p + new_to);
-        // 将还指向from的引用更新为forwarding pointer，即to中的pointer
-        for (int i = 0; i < obj->clss->num_fields; ++i) {
-            object** field = (object **) ((void *)obj + obj->clss->field_offsets[i]);
-            if ((*field) && (*field)->forwarding) {
-                *field = (*field)->forwarding;
-            }
-        }
-
-        // 顺序访问下一个对象
-        p = p + obj->clss->size;
-    }
-}
-
 /**
  * @brief 修改引用
  * 
@@ -357,186 +676,1436 @@ void gc_update_ptr(object* obj, object** field_ref, object* new_obj) {
  */
 void write_barrier(object* obj, object** field_ref, object* new_obj) {
 
+    // 卡片标记：不做任何判断，直接设置发出引用的对象所在卡片的标志位
+    if (gc_rs_mode == RS_CARD) {
+        card_table[((void *) obj - heap) / CARD_SIZE] = CARD_DIRTY;
+        *field_ref = new_obj;
+        return;
+    }
+
+    // 顺序存储缓冲区：不做任何判断，只追加域的地址，新生代中的域在倒空缓冲区时丢弃
+    if (gc_rs_mode == RS_SSB) {
+        ssb_buffer* buffer = ssb ? ssb : ssb_register();
+        *field_ref = new_obj;
+        buffer->slots[buffer->top++] = field_ref;
+        if (buffer->top == SSB_SIZE) {
+            ssb_flush(buffer);
+        }
+        return;
+    }
+
     /**
      * 为了将老年代对象记录到记录集里
      *  1. 发出引用的对象是不是老年代对象
      *  2. 指针更新后的引用的目标对象是不是新生代对象
      *  3. 发出引用的对象是否还没有被记录到记录集中
     */
-    if ((void *)obj >= old && (void*) new_obj <= new_eden + eden_size + survivor_size && !obj->remembered) {
-        _rs[_rsp++] = obj;
+    if ((void *)obj >= old && is_young(new_obj) && !obj->remembered) {
+        remember(obj);
     }
 
     *field_ref = new_obj;
 }
 
 /**
- * @brief 新生代gc
+ * @brief 记录引用了新生代对象的老年代对象
  * 
+ * @param obj 
  */
-void minor_gc() {
-    printf("minor gc\n");
-    next_forwarding_offset = 0;
-
-    // 遍历GC ROOTS
-    for (int i = 0; i < _rp; ++i) {
-        object* root = _roots[i];
+void remember(object* obj) {
+    if (gc_rs_mode == RS_CARD) {
+        card_table[((void *) obj - heap) / CARD_SIZE] = CARD_DIRTY;
+        return;
+    }
 
-        // 只处理处于新生代中的root，地址小于to的部分
-        if ((void *)root <= (void *)new_eden + eden_size + survivor_size) {
-            object* forwarding = new_copy(root);
+    // 并行新生代GC时多个线程会同时记录
+    pthread_mutex_lock(&remember_lock);
 
-            // 先将GC ROOTS引用的对象更新到to空间的新对象
-            _roots[i] = forwarding;
+    // 记录还指向新生代的域
+    if (gc_rs_mode == RS_SSB) {
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            object** slot = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+            if (is_young(*slot)) {
+                slot_set_add(slot);
+            }
+        }
+    } else if (!obj->remembered) {
+        if (_rsp >= MAX_ROOTS) {
+            printf("[New]Remembered set overflow!\n");
+            abort();
         }
-    }
 
-    int i = 0;
-    // 找到rs中的跨代引用
-    while (i < _rsp) {
-        object* old_root = _rs[i];
-        byte has_new_obj = FALSE;
+        obj->remembered = TRUE;
+        _rs[_rsp++] = obj;
+    }
 
-        for (int i = 0; i < old_root->clss->num_fields; ++i) {
-            object** new_object_p = (object**)((void *) old_root + old_root->clss->field_offsets[i]);
-            object* new_object = *new_object_p;
+    pthread_mutex_unlock(&remember_lock);
+}
 
-            if ((void *)new_object < (void *)old) {
-                object* forwarding = new_copy(new_object);
+/**
+ * @brief 复制对象引用的新生代对象，并将引用更新为复制之后的对象
+ * 
+ * @param obj 老年代对象或者to空间中的对象
+ * @return byte 更新后是否还引用着新生代对象
+ */
+byte scan_object(object* obj) {
+    byte has_new_obj = FALSE;
 
-                // 将老年代对新生代的引用更新为复制之后的对象
-                *new_object_p = forwarding;
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        object** new_object_p = (object**)((void *) obj + obj->clss->field_offsets[i]);
 
-                if ((void *) forwarding < (void *)old) {
-                    has_new_obj = TRUE;
-                }
-            }
-        }
+        if (is_young(*new_object_p)) {
+            object* forwarding = new_copy(*new_object_p);
 
-        // 如果该老年代对象引用的所有新生代对象都已经晋升到老年代，则删除rs中这个记录
-        if (!has_new_obj) {
-            _rs[i]->remembered = FALSE;
+            // 将老年代对新生代的引用更新为复制之后的对象
+            *new_object_p = forwarding;
 
-            // 如果不是最后一个元素，就先交换
-            if (i < _rsp - 1) {
-                swap((void **)&_rs[i], (void **)(&_rs[_rsp]));
+            if (is_young(forwarding)) {
+                has_new_obj = TRUE;
             }
-
-            // 移除最后一个
-            _rs[--_rsp] = NULL;
-        } else {
-            i++;
         }
     }
 
-    // 更新引用
-    adjust_ref();
+    return has_new_obj;
+}
 
-    // 清空Eden/from
-    next_free_offset = 0;
-    memset(new_eden, 0, eden_size);
-    memset(new_from, 0, survivor_size);
+/**
+ * @brief 搜索记录集
+ *  1. 如果该老年代对象引用的所有新生代对象都已经晋升到老年代，则删除rs中这个记录
+ * 
+ */
+void scan_remembered_set() {
+    int i = 0;
+    // 找到rs中的跨代引用
+    while (i < _rsp) {
+        if (scan_object(_rs[i])) {
+            i++;
+            continue;
+        }
 
-    swap((void **)&new_from, (void **)&new_to);
+        _rs[i]->remembered = FALSE;
 
+        // 用最后一个元素填补被删除的位置，填补的元素还需要再检查
+        _rs[i] = _rs[--_rsp];
+        _rs[_rsp] = NULL;
+    }
 }
 
 /**
- * @brief 对象晋升
+ * @brief 搜索卡片表格
+ *  1. 只搜索老年代的卡片，找到设置了标志位的卡片后，搜索对象头位于卡片中的所有对象
+ *  2. 搜索后不再引用新生代对象的卡片会被清除标志位
+ *  3. 新生代的卡片是写入屏障不做判断而设置的，直接清除
  * 
- * @param obj 
  */
-void promotion(object* obj) {
-    printf("promotion...\n");
-    object* new_obj = old_malloc(obj);
-    obj->forwarding = new_obj;
-    obj->forwarded = TRUE;
+void scan_dirty_cards() {
+    int first_old_card = (old - heap) / CARD_SIZE;
 
-    for (int i = 0; i < new_obj->clss->num_fields; ++i) {
-        object* ref_obj = *(object **) ((void*) new_obj + new_obj->clss->field_offsets[i]);
+    memset(card_table, CARD_CLEAN, first_old_card);
 
-        // 如果晋升后的对象还引用着新生代对象，则记录再rs中
-        if (ref_obj && (void*)ref_obj <= (void *)old) {
-            new_obj->remembered = true;
-            _rs[_rsp++] = new_obj;
-            break;
+    for (int card = first_old_card; card < num_cards; ++card) {
+        if (card_table[card] == CARD_CLEAN) {
+            continue;
         }
+
+        card_table[card] = CARD_CLEAN;
+
+        visit_card(card, scan_card_object);
+    }
+}
+
+void scan_card_object(object* obj, int card) {
+    if (scan_object(obj)) {
+        card_table[card] = CARD_DIRTY;
     }
 }
 
 /**
- * @brief 老年代gc
+ * @brief 遍历对象头位于卡片中的所有对象
  * 
+ * @param card 
+ * @param visitor 
  */
-void major_gc() {
-    for (int i = 0; i < _rp; ++i) {
-        // 遍历老年区的节点
-        object* root = _roots[i];
-        if ((void *)root > old) {
-            old_mark(_roots[i]);
-        }
-    }
-    old_sweep();
+void visit_card(int card, void (*visitor)(object* obj, int card)) {
+    old_gen->visit_card(card, visitor);
 }
 
 /**
- * @brief 老年代标记
+ * @brief 为当前线程分配顺序存储缓冲区
+ *  1. 注册到ssb_buffers中，GC时才能倒空所有线程的缓冲区
  * 
- * @param obj 
+ * @return ssb_buffer* 
  */
-void old_mark(object* obj) {
-    // 递归剪枝
-    if (!obj || obj->marked) { return; }
+void ssb_create_key() {
+    pthread_key_create(&ssb_key, ssb_unregister);
+}
 
-    obj->marked = TRUE;
-    printf("marking...\n");
+ssb_buffer* ssb_register() {
+    pthread_once(&ssb_key_once, ssb_create_key);
 
-    // 递归标记对象的引用
-    for (int i = 0; i < obj->clss->num_fields; ++i) {
-        // 只对引用的老年代部分对象标记，major gc只回收老年代
-        object* ref_obj = *((object **) ((void *) obj + obj->clss->field_offsets[i]));
-        if ((void *)ref_obj >= old) {
-            old_mark(ref_obj);
-        }
+    pthread_mutex_lock(&ssb_lock);
+    if (num_ssb_buffers >= MAX_THREADS) {
+        printf("[New]Too many mutator threads!\n");
+        abort();
     }
+
+    ssb = (ssb_buffer *) calloc(1, sizeof(ssb_buffer));
+    ssb_buffers[num_ssb_buffers++] = ssb;
+    pthread_mutex_unlock(&ssb_lock);
+
+    // 线程退出时自动注销
+    pthread_setspecific(ssb_key, ssb);
+    return ssb;
 }
 
 /**
- * @brief 老年代清除
+ * @brief 注销线程的顺序存储缓冲区
+ *  1. 先把剩下的域倒入记录集，再从ssb_buffers中移除并释放，GC不会再读取已经退出的线程的缓冲区
+ *  2. 持有ssb_lock，不会和ssb_flush_all同时倒空同一个缓冲区
  * 
+ * @param buffer 
  */
-void old_sweep() {
-    int i = 0, step = 0;
-
-    for (node* _cur = old_head; _cur && _cur; _cur = _cur->next) {
-        if (!_cur->used) continue;
-        object* obj = _cur->data;
-        
-        if (obj->marked) {
-            obj->marked = FALSE;
-        } else {
-            // 回收对象所属的node
-            memset(obj, 0, obj->clss->size);
-
-            // 通过地址计算出，对象所在的node
-            node* _node = (node*) ((void *) obj - sizeof(node));
-            _node->used = FALSE;
-            _node->data = NULL;
-            _node->size = 0;
-
-            // 将next_free更新为当前回收的node
-            old_next_free = _node;
-            printf("collection ...\n");
+void ssb_unregister(void* buffer) {
+    pthread_mutex_lock(&ssb_lock);
+    ssb_flush((ssb_buffer *) buffer);
+    for (int i = 0; i < num_ssb_buffers; ++i) {
+        if (ssb_buffers[i] == buffer) {
+            ssb_buffers[i] = ssb_buffers[--num_ssb_buffers];
+            break;
         }
     }
+    pthread_mutex_unlock(&ssb_lock);
+
+    free(buffer);
+    ssb = NULL;
 }
 
 /**
- * @brief 获取GC状态
+ * @brief 域是否位于一个使用中的老年代对象中
  * 
- * @return char* 
+ * @param slot 
+ * @return byte 
  */
-char* gc_get_state() {
+byte is_old_slot(object** slot) {
+    return old_gen->contains_slot(slot);
+}
+
+/**
+ * @brief 把缓冲区中的域去重后加入记录集
+ *  1. 丢弃新生代中的域，以及已经不指向新生代对象的域
+ *  2. 多个线程的缓冲区可能同时满了，slot记录集和remember()一样由remember_lock保护
+ * 
+ * @param buffer 
+ */
+void ssb_flush(ssb_buffer* buffer) {
+    pthread_mutex_lock(&remember_lock);
+    for (int i = 0; i < buffer->top; ++i) {
+        object** slot = buffer->slots[i];
+        if (is_old_slot(slot) && is_young(*slot)) {
+            slot_set_add(slot);
+        }
+    }
+    pthread_mutex_unlock(&remember_lock);
+
+    buffer->top = 0;
+}
+
+void ssb_flush_all() {
+    pthread_mutex_lock(&ssb_lock);
+    for (int i = 0; i < num_ssb_buffers; ++i) {
+        ssb_flush(ssb_buffers[i]);
+    }
+    pthread_mutex_unlock(&ssb_lock);
+}
+
+/**
+ * @brief 加入slot记录集
+ *  1. 线性探测的开放寻址哈希集合，同一个域只会记录一次
+ *  2. 装填因子超过1/2时扩容
+ * 
+ * @param slot 
+ */
+void slot_set_add(object** slot) {
+    if ((slot_set_count + 1) * 2 > slot_set_capacity) {
+        object*** old_set = slot_set;
+        int old_capacity = slot_set_capacity;
+
+        slot_set_capacity *= 2;
+        slot_set = (object ***) calloc(slot_set_capacity, sizeof(object **));
+        slot_set_count = 0;
+
+        for (int i = 0; i < old_capacity; ++i) {
+            if (old_set[i]) {
+                slot_set_add(old_set[i]);
+            }
+        }
+        free(old_set);
+    }
+
+    int i = (((uintptr_t) slot >> 3) * 2654435761u) & (slot_set_capacity - 1);
+    while (slot_set[i]) {
+        if (slot_set[i] == slot) {
+            return;
+        }
+        i = (i + 1) & (slot_set_capacity - 1);
+    }
+
+    slot_set[i] = slot;
+    slot_set_count++;
+}
+
+/**
+ * @brief 重建slot记录集
+ *  1. 开放寻址不方便删除，所以把还需要保留的域重新插入到新的集合中
+ *  2. scavenge为TRUE时，复制域引用的新生代对象并更新域，只保留还指向新生代的域
+ *  3. scavenge为FALSE时，只删除已经被回收的老年代对象中的域
+ * 
+ * @param scavenge 
+ */
+void slot_set_rebuild(byte scavenge) {
+    // 晋升的对象会在复制过程中加入记录集，所以先换上一个空的集合
+    object*** old_set = slot_set;
+    int old_capacity = slot_set_capacity;
+
+    slot_set = (object ***) calloc(slot_set_capacity, sizeof(object **));
+    slot_set_count = 0;
+
+    for (int i = 0; i < old_capacity; ++i) {
+        object** slot = old_set[i];
+        if (!slot || !is_old_slot(slot)) continue;
+
+        if (scavenge && is_young(*slot)) {
+            *slot = new_copy(*slot);
+        }
+
+        if (is_young(*slot)) {
+            slot_set_add(slot);
+        }
+    }
+
+    free(old_set);
+}
+
+/**
+ * @brief 搜索slot记录集
+ *  1. 先倒空所有线程的缓冲区，然后只更新被记录的域，不用搜索整个对象
+ * 
+ */
+void scan_slot_set() {
+    ssb_flush_all();
+    slot_set_rebuild(TRUE);
+}
+
+/**
+ * @brief 并行新生代GC
+ *  1. 先在单线程中做好任务的快照：记录集/卡片中的老年代对象，slot记录集中的域
+ *  2. 多个线程分别领取GC ROOTS和快照中的任务，复制的对象放入自己的灰色对象队列
+ *  3. 自己的队列空了就去窃取其他线程的灰色对象，所有线程都找不到灰色对象时结束
+ *  4. 幸存空间和晋升都在线程本地的缓冲区中分配，结束后填充缓冲区的剩余空间，保证空间可以逐个对象地遍历
+ * 
+ */
+void parallel_minor_gc() {
+    num_old_tasks = 0;
+    num_slot_tasks = 0;
+
+    if (gc_rs_mode == RS_CARD) {
+        int first_old_card = (old - heap) / CARD_SIZE;
+        memset(card_table, CARD_CLEAN, first_old_card);
+
+        for (int card = first_old_card; card < num_cards; ++card) {
+            if (card_table[card] == CARD_DIRTY) {
+                card_table[card] = CARD_CLEAN;
+                visit_card(card, add_old_task);
+            }
+        }
+    } else if (gc_rs_mode == RS_SSB) {
+        // 换上一个空的集合，还指向新生代的域会重新加入
+        ssb_flush_all();
+        slot_tasks = slot_set;
+        num_slot_tasks = slot_set_capacity;
+        slot_set = (object ***) calloc(slot_set_capacity, sizeof(object **));
+        slot_set_count = 0;
+    } else {
+        for (int i = 0; i < _rsp; ++i) {
+            _rs[i]->remembered = FALSE;
+            add_old_task(_rs[i], 0);
+        }
+        _rsp = 0;
+    }
+
+    next_root = 0;
+    next_old_task = 0;
+    next_slot_task = 0;
+    idle_workers = 0;
+
+    for (int i = 0; i < parallel_workers; ++i) {
+        gc_worker* w = &workers[i];
+        if (!w->deque) {
+            w->capacity = 64;
+            w->deque = (object **) malloc(w->capacity * sizeof(object *));
+            pthread_mutex_init(&w->lock, NULL);
+        }
+        w->top = w->bottom = 0;
+        w->lab_top = w->lab_end = NULL;
+        w->plab_top = w->plab_end = NULL;
+    }
+
+    pthread_t threads[MAX_WORKERS];
+    for (int i = 0; i < parallel_workers; ++i) {
+        pthread_create(&threads[i], NULL, parallel_scavenge, &workers[i]);
+    }
+    for (int i = 0; i < parallel_workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // 填充线程本地缓冲区的剩余空间
+    if (next_forwarding_offset > survivor_size) {
+        next_forwarding_offset = survivor_size;
+    }
+    for (int i = 0; i < parallel_workers; ++i) {
+        fill(workers[i].lab_top, workers[i].lab_end);
+        old_gen->retire(&workers[i]);
+    }
+
+    free(slot_tasks);
+    slot_tasks = NULL;
+}
+
+void add_old_task(object* obj, int card) {
+    if (num_old_tasks == old_tasks_capacity) {
+        old_tasks_capacity = old_tasks_capacity ? old_tasks_capacity * 2 : 64;
+        old_tasks = (object **) realloc(old_tasks, old_tasks_capacity * sizeof(object *));
+    }
+    old_tasks[num_old_tasks++] = obj;
+}
+
+int claim(int* next) {
+    return __atomic_fetch_add(next, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief 并行新生代GC的线程
+ * 
+ * @param arg 线程对应的gc_worker
+ */
+void* parallel_scavenge(void* arg) {
+    gc_worker* w = (gc_worker *) arg;
+
+    // GC ROOTS
+    for (int i = claim(&next_root); i < _rp; i = claim(&next_root)) {
+        if (is_young(_roots[i])) {
+            _roots[i] = par_copy(w, _roots[i]);
+        }
+    }
+
+    // 记录集/卡片中的老年代对象
+    for (int i = claim(&next_old_task); i < num_old_tasks; i = claim(&next_old_task)) {
+        if (par_scan(w, old_tasks[i])) {
+            remember(old_tasks[i]);
+        }
+    }
+
+    // slot记录集中的域
+    for (int i = claim(&next_slot_task); i < num_slot_tasks; i = claim(&next_slot_task)) {
+        object** slot = slot_tasks[i];
+        if (!slot || !is_old_slot(slot)) continue;
+
+        if (is_young(*slot)) {
+            *slot = par_copy(w, *slot);
+        }
+
+        if (is_young(*slot)) {
+            pthread_mutex_lock(&remember_lock);
+            slot_set_add(slot);
+            pthread_mutex_unlock(&remember_lock);
+        }
+    }
+
+    // 搜索灰色对象，晋升的对象还引用着新生代对象时记录下来
+    object* obj = worker_pop(w);
+    while (obj || (obj = worker_steal(w))) {
+        if (par_scan(w, obj) && (void *) obj >= old) {
+            remember(obj);
+        }
+        obj = worker_pop(w);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 复制对象引用的新生代对象并更新域
+ *  1. 每个对象只会被一个线程搜索，所以更新域不需要同步
+ * 
+ * @param w
+ * @param obj
+ * @return byte 更新后是否还引用着新生代对象
+ */
+byte par_scan(gc_worker* w, object* obj) {
+    byte has_new_obj = FALSE;
+
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+
+        if (is_young(*field)) {
+            *field = par_copy(w, *field);
+
+            if (is_young(*field)) {
+                has_new_obj = TRUE;
+            }
+        }
+    }
+
+    return has_new_obj;
+}
+
+/**
+ * @brief 复制对象
+ *  1. 先在线程本地的缓冲区中复制，再用CAS把复制后的指针写入原对象的forwarding
+ *  2. CAS失败说明其他线程先复制了，撤销自己的复制，使用其他线程的复制结果
+ *  3. CAS成功的线程负责搜索复制后的对象
+ * 
+ * @param w
+ * @param obj
+ * @return object* 复制后的对象指针
+ */
+object* par_copy(gc_worker* w, object* obj) {
+    // 已经在to空间中的对象不需要再复制
+    if ((void *) obj >= new_to && (void *) obj < new_to + survivor_size) { return obj; }
+
+    object* forwarding = __atomic_load_n(&obj->forwarding, __ATOMIC_ACQUIRE);
+    if (forwarding) {
+        return forwarding;
+    }
+
+    // 幸存空间放不下时提前晋升
+    object* copy = stays_young(obj) ? (object *) survivor_lab_alloc(w, obj->clss->size) : NULL;
+    if (copy) {
+        memcpy(copy, obj, obj->clss->size);
+        if (copy->age < MAX_AGE) {
+            copy->age++;
+        }
+    } else {
+        if (stays_young(obj)) {
+            __atomic_add_fetch(&overflow_bytes, obj->clss->size, __ATOMIC_RELAXED);
+        }
+        copy = par_old_malloc(w, obj);
+    }
+
+    copy->forwarded = FALSE;
+    copy->marked = FALSE;
+    copy->remembered = FALSE;
+    copy->forwarding = NULL;
+
+    object* expected = NULL;
+    if (!__atomic_compare_exchange_n(&obj->forwarding, &expected, copy, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        par_undo(w, copy);
+        return expected;
+    }
+
+    obj->forwarded = TRUE;
+    if (gc_pretenuring && is_eden(obj)) {
+        __atomic_add_fetch(&obj->clss->survived, 1, __ATOMIC_RELAXED);
+    }
+    if ((void *) copy < old) {
+        __atomic_add_fetch(&age_table[copy->age], copy->clss->size, __ATOMIC_RELAXED);
+    }
+    worker_push(w, copy);
+
+    return copy;
+}
+
+/**
+ * @brief 在线程本地的幸存空间缓冲区中分配
+ *  1. 缓冲区用完时，用原子操作从幸存空间中领取下一个缓冲区
+ *  2. 超过缓冲区一半大小的对象直接在幸存空间中分配
+ * 
+ * @param w
+ * @param size
+ * @return void* 幸存空间放不下时返回NULL
+ */
+void* survivor_lab_alloc(gc_worker* w, int size) {
+    if (w->lab_top && w->lab_top + size <= w->lab_end) {
+        void* addr = w->lab_top;
+        w->lab_top += size;
+        return addr;
+    }
+
+    int lab_size = size > SURVIVOR_LAB_SIZE / 2 ? size : SURVIVOR_LAB_SIZE;
+    int offset = __atomic_fetch_add(&next_forwarding_offset, lab_size, __ATOMIC_SEQ_CST);
+
+    // 领取的空间超出幸存空间时，只使用幸存空间中剩下的部分
+    void* start = offset < survivor_size ? offset + new_to : NULL;
+    void* end = offset + lab_size < survivor_size ? offset + lab_size + new_to : survivor_size + new_to;
+
+    if (!start || start + size > end) {
+        fill(start, end);
+        return NULL;
+    }
+
+    if (lab_size == size) {
+        return start;
+    }
+
+    fill(w->lab_top, w->lab_end);
+    w->lab_top = start + size;
+    w->lab_end = end;
+
+    return start;
+}
+
+/**
+ * @brief 晋升
+ *  1. 在老年代收集器中分配，w用来使用线程本地的缓冲区
+ * 
+ * @param w
+ * @param obj
+ * @return object*
+ */
+object* par_old_malloc(gc_worker* w, object* obj) {
+    object* new_obj = old_gen->alloc(w, obj->clss->size);
+
+    memcpy(new_obj, obj, obj->clss->size);
+
+    return new_obj;
+}
+
+/**
+ * @brief 撤销没有抢到forwarding指针的复制
+ *  1. 复制的对象是缓冲区中最后分配的对象时，直接退回缓冲区
+ *  2. 否则用filler填充，晋升的对象交给老年代收集器撤销
+ * 
+ * @param w
+ * @param copy
+ */
+void par_undo(gc_worker* w, object* copy) {
+    int size = copy->clss->size;
+
+    if ((void *) copy >= old) {
+        old_gen->undo(w, copy);
+    } else if ((void *) copy + size == w->lab_top) {
+        w->lab_top = copy;
+    } else {
+        fill(copy, (void *) copy + size);
+    }
+}
+
+void fill(void* start, void* end) {
+    for (void* p = start; p && p < end; p += filler_class.size) {
+        ((object *) p)->clss = &filler_class;
+    }
+}
+
+void worker_push(gc_worker* w, object* obj) {
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom == w->capacity) {
+        w->capacity *= 2;
+        w->deque = (object **) realloc(w->deque, w->capacity * sizeof(object *));
+    }
+    w->deque[w->bottom] = obj;
+    __atomic_store_n(&w->bottom, w->bottom + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&w->lock);
+}
+
+object* worker_pop(gc_worker* w) {
+    object* obj = NULL;
+
+    // 其他线程会不加锁地查看top和bottom，所以用原子操作写入
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom > w->top) {
+        obj = w->deque[w->bottom - 1];
+        __atomic_store_n(&w->bottom, w->bottom - 1, __ATOMIC_RELEASE);
+    }
+    if (w->bottom == w->top) {
+        __atomic_store_n(&w->bottom, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&w->top, 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return obj;
+}
+
+/**
+ * @brief 从其他线程的队列顶部窃取灰色对象
+ *  1. 先把自己计入空闲线程，看到其他线程有灰色对象时退出空闲再去窃取
+ *  2. 只有持有灰色对象的线程才能产生新的灰色对象，所以所有线程都空闲时就不会再有灰色对象了
+ * 
+ * @param w
+ * @return object* 所有线程都空闲时返回NULL
+ */
+object* worker_steal(gc_worker* w) {
+    __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(&idle_workers, __ATOMIC_SEQ_CST) < parallel_workers) {
+        for (int i = 0; i < parallel_workers; ++i) {
+            gc_worker* victim = &workers[i];
+            if (victim == w || __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE) <= __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            __atomic_sub_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+
+            object* obj = NULL;
+            pthread_mutex_lock(&victim->lock);
+            if (victim->bottom > victim->top) {
+                obj = victim->deque[victim->top];
+                __atomic_store_n(&victim->top, victim->top + 1, __ATOMIC_RELEASE);
+            }
+            pthread_mutex_unlock(&victim->lock);
+
+            if (obj) {
+                return obj;
+            }
+
+            __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+        }
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 新生代gc
+ * 
+ */
+void minor_gc() {
+    // 直接在老年代中分配时使用的PLAB，不能留给并行新生代GC的线程
+    old_gen->retire(NULL);
+
+    // 不能在新生代GC进行到一半时进行老年代GC
+    ensure_promotion_space();
+
+    printf("minor gc\n");
+    next_forwarding_offset = 0;
+    memset(age_table, 0, sizeof(age_table));
+    overflow_bytes = 0;
+
+    if (parallel_workers > 1) {
+        parallel_minor_gc();
+    } else {
+        serial_minor_gc();
+    }
+
+    // 清空Eden/from
+    next_free_offset = 0;
+    memset(new_eden, 0, eden_size);
+    memset(new_from, 0, survivor_size);
+
+    swap((void **)&new_from, (void **)&new_to);
+
+    // PLAB只在一次GC中使用
+    old_gen->retire(NULL);
+
+    if (gc_pretenuring) {
+        update_pretenuring();
+    }
+
+    if (gc_adaptive_sizing) {
+        compute_tenuring_threshold();
+        resize_young();
+    }
+}
+
+/**
+ * @brief 根据年龄分布计算晋升年龄
+ *  1. 从年龄小的对象开始累加大小，超过幸存空间的TARGET_SURVIVOR_RATIO时，这个年龄及以上的对象下次GC时晋升
+ *  2. 存活的对象少时晋升年龄回到MAX_AGE
+ * 
+ */
+void compute_tenuring_threshold() {
+    int desired = survivor_size / 100 * TARGET_SURVIVOR_RATIO;
+    int total = 0;
+    int age = 1;
+
+    for (; age < MAX_AGE; ++age) {
+        total += age_table[age];
+        if (total > desired) {
+            break;
+        }
+    }
+
+    tenuring_threshold = age;
+}
+
+/**
+ * @brief 根据存活的大小调整eden和survivor的大小
+ *  1. 新生代的总大小不变，幸存空间调整为平均存活大小的100/TARGET_SURVIVOR_RATIO倍，剩下的都给eden
+ *  2. 存活大小包括幸存空间放不下而提前晋升的对象
+ *  3. 需要更大时立即扩大，只有小于3/4时才缩小，避免每次GC都来回移动幸存空间
+ *  4. 调整后的布局仍然是eden、from、to，幸存空间中的对象要移动到新的from
+ * 
+ */
+void resize_young() {
+    avg_survived = (avg_survived * 3 + next_forwarding_offset + overflow_bytes) / 4;
+
+    int desired = avg_survived / TARGET_SURVIVOR_RATIO * 100;
+    int min_size = new_size / MIN_SURVIVOR_FRACTION;
+    int max_size = new_size / MAX_SURVIVOR_FRACTION;
+
+    desired = desired < min_size ? min_size : (desired > max_size ? max_size : desired);
+    desired = desired / 8 * 8;
+
+    if (desired == survivor_size || (desired < survivor_size && desired > survivor_size / 4 * 3) || desired < next_forwarding_offset) {
+        return;
+    }
+
+    printf("resize survivor %d -> %d\n", survivor_size, desired);
+
+    int new_eden_size = new_size - desired * 2;
+    move_survivors(new_eden + new_eden_size);
+
+    eden_size = new_eden_size;
+    survivor_size = desired;
+    new_from = new_eden + eden_size;
+    new_to = new_from + survivor_size;
+
+    // 调整前幸存空间的位置可能变成了eden或者to
+    memset(new_eden, 0, eden_size);
+    memset(new_to, 0, survivor_size);
+}
+
+void move_pointer(object** field, void* start, void* end, long delta) {
+    if ((void *) *field >= start && (void *) *field < end) {
+        *field = (object *) ((void *) *field + delta);
+    }
+}
+
+/**
+ * @brief 移动幸存空间中的对象
+ *  1. 幸存空间中的对象整体平移，所以只需要给指向它们的指针加上相同的偏移
+ *  2. 指向幸存空间的指针只存在于GC ROOTS、幸存空间中的对象、记录集/卡片/slot记录集记录的老年代对象中
+ * 
+ * @param target 新的from空间
+ */
+void move_survivors(void* target) {
+    void* start = new_from;
+    void* end = new_from + next_forwarding_offset;
+    long delta = target - start;
+
+    if (delta == 0) {
+        return;
+    }
+
+    for (int i = 0; i < _rp; ++i) {
+        move_pointer(&_roots[i], start, end, delta);
+    }
+
+    for (void* p = start; p < end; p += ((object *) p)->clss->size) {
+        object* obj = (object *) p;
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            move_pointer((object **) ((void *) obj + obj->clss->field_offsets[i]), start, end, delta);
+        }
+    }
+
+    if (gc_rs_mode == RS_CARD) {
+        for (int card = (old - heap) / CARD_SIZE; card < num_cards; ++card) {
+            if (card_table[card] == CARD_DIRTY) {
+                num_old_tasks = 0;
+                visit_card(card, add_old_task);
+                for (int j = 0; j < num_old_tasks; ++j) {
+                    for (int i = 0; i < old_tasks[j]->clss->num_fields; ++i) {
+                        move_pointer((object **) ((void *) old_tasks[j] + old_tasks[j]->clss->field_offsets[i]), start, end, delta);
+                    }
+                }
+            }
+        }
+    } else if (gc_rs_mode == RS_SSB) {
+        ssb_flush_all();
+        for (int i = 0; i < slot_set_capacity; ++i) {
+            if (slot_set[i]) {
+                move_pointer(slot_set[i], start, end, delta);
+            }
+        }
+    } else {
+        for (int j = 0; j < _rsp; ++j) {
+            for (int i = 0; i < _rs[j]->clss->num_fields; ++i) {
+                move_pointer((object **) ((void *) _rs[j] + _rs[j]->clss->field_offsets[i]), start, end, delta);
+            }
+        }
+    }
+
+    memmove(target, start, next_forwarding_offset);
+}
+
+/**
+ * @brief 单线程的新生代GC
+ * 
+ */
+void serial_minor_gc() {
+
+    // 遍历GC ROOTS
+    for (int i = 0; i < _rp; ++i) {
+        object* root = _roots[i];
+
+        // 只处理处于新生代中的root
+        if (is_young(root)) {
+            object* forwarding = new_copy(root);
+
+            // 先将GC ROOTS引用的对象更新到to空间的新对象
+            _roots[i] = forwarding;
+        }
+    }
+
+    // 把老年代到新生代的引用当作根
+    if (gc_rs_mode == RS_CARD) {
+        scan_dirty_cards();
+    } else if (gc_rs_mode == RS_SSB) {
+        scan_slot_set();
+    } else {
+        scan_remembered_set();
+    }
+
+    // 搜索复制和晋升的对象
+    scavenge();
+}
+
+/**
+ * @brief 广度优先地搜索复制和晋升的对象(Cheney算法)
+ *  1. to空间中scan和next_forwarding_offset之间的对象是灰色对象，搜索时复制它们引用的对象并立即更新域
+ *  2. 晋升的对象没有放在to空间中，所以单独用晋升列表记录，同样当作灰色对象搜索
+ *  3. 搜索晋升的对象后，如果它还引用着新生代对象，则记录在rs中
+ *  4. 两边都没有灰色对象时结束，不需要递归，也不需要再遍历一次to空间更新引用
+ * 
+ */
+void scavenge() {
+    int scan = 0;
+    int promoted_scan = 0;
+
+    while (scan < next_forwarding_offset || promoted_scan < promoted_count) {
+        while (scan < next_forwarding_offset) {
+            object* obj = (object *) (scan + new_to);
+            scan_object(obj);
+            scan += obj->clss->size;
+        }
+
+        while (promoted_scan < promoted_count) {
+            object* obj = promoted[promoted_scan++];
+            if (scan_object(obj)) {
+                remember(obj);
+            }
+        }
+    }
+
+    promoted_count = 0;
+}
+
+/**
+ * @brief 对象晋升
+ * 
+ * @param obj 
+ */
+void promotion(object* obj) {
+    printf("promotion...\n");
+    object* new_obj = old_malloc(obj);
+    obj->forwarding = new_obj;
+    obj->forwarded = TRUE;
+
+    // 晋升后的对象也要复制它引用的新生代对象，加入晋升列表，由scavenge()搜索
+    if (promoted_count == promoted_capacity) {
+        promoted_capacity = promoted_capacity ? promoted_capacity * 2 : 16;
+        promoted = (object **) realloc(promoted, promoted_capacity * sizeof(object *));
+    }
+    promoted[promoted_count++] = new_obj;
+}
+
+/**
+ * @brief 老年代gc
+ *  1. 从所有GC ROOTS出发标记，新生代对象也会被搜索，但是不会被回收
+ *  2. 只有从活动的新生代对象出发能到达的老年代对象才是活动对象，记录集只用于新生代GC
+ *  3. 回收交给老年代收集器，结束后清除新生代对象的标记
+ * 
+ */
+void major_gc() {
+    printf("major gc\n");
+
+    // 压缩时要能从头到尾逐个对象地遍历老年代
+    old_gen->retire(NULL);
+
+    // 回收之后缓冲区中的域可能已经无效了
+    ssb_flush_all();
+
+    major_mark();
+    old_gen->reclaim();
+    clear_young_marks();
+}
+
+/**
+ * @brief 从所有GC ROOTS出发，经过新生代对象标记
+ *  1. 使用标记栈而不是递归，很长的链表也不会栈溢出
+ * 
+ */
+void major_mark() {
+    for (int i = 0; i < _rp; ++i) {
+        mark_push(_roots[i]);
+    }
+
+    while (mark_sp > 0) {
+        object* obj = mark_stack[--mark_sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            mark_push(*(object **) ((void *) obj + obj->clss->field_offsets[i]));
+        }
+    }
+}
+
+void mark_push(object* obj) {
+    if (!obj || obj->marked) {
+        return;
+    }
+
+    obj->marked = TRUE;
+
+    if (mark_sp == mark_stack_capacity) {
+        mark_stack_capacity = mark_stack_capacity ? mark_stack_capacity * 2 : 64;
+        mark_stack = (object **) realloc(mark_stack, mark_stack_capacity * sizeof(object *));
+    }
+    mark_stack[mark_sp++] = obj;
+}
+
+/**
+ * @brief 清除新生代对象的标记
+ * 
+ */
+void clear_young_marks() {
+    void* spaces[2] = { new_eden, new_from };
+    int tops[2] = { next_free_offset, next_forwarding_offset };
+
+    for (int s = 0; s < 2; ++s) {
+        for (void* p = spaces[s]; p < spaces[s] + tops[s]; p += ((object *) p)->clss->size) {
+            if (((object *) p)->clss != &filler_class) {
+                ((object *) p)->marked = FALSE;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 保证新生代GC时老年代能容纳所有晋升对象
+ *  1. 新生代GC进行到一半时不能进行老年代GC，否则会回收或者移动正在复制的对象
+ *  2. 最坏情况下eden和from中的对象全部晋升，不够就先进行老年代GC
+ * 
+ */
+void ensure_promotion_space() {
+    if (old_gen->promotable_bytes() < next_free_offset + next_forwarding_offset) {
+        printf("[Old]Insufficient promotion space. execute gc...\n");
+        major_gc();
+    }
+}
+
+/**
+ * @brief 老年代压缩
+ *  1. 和Lisp2算法一样分三步：设定forwarding指针、更新指针、移动对象
+ *  2. 除了GC ROOTS和老年代对象，活动的新生代对象引用的老年代对象也要更新
+ * 
+ */
+void old_compact() {
+    // 设定forwarding指针
+    void* scan = old;
+    for (void* p = old; p < old_top; p += ((object *) p)->clss->size) {
+        object* obj = (object *) p;
+        if (obj->clss != &filler_class && obj->marked) {
+            obj->forwarding = scan;
+            scan += obj->clss->size;
+        }
+    }
+
+    // 更新指针
+    for (int i = 0; i < _rp; ++i) {
+        if ((void *) _roots[i] >= old) {
+            _roots[i] = _roots[i]->forwarding;
+        }
+    }
+
+    void* spaces[3] = { new_eden, new_from, old };
+    void* tops[3] = { new_eden + next_free_offset, new_from + next_forwarding_offset, old_top };
+
+    for (int s = 0; s < 3; ++s) {
+        for (void* p = spaces[s]; p < tops[s]; p += ((object *) p)->clss->size) {
+            object* obj = (object *) p;
+            if (obj->clss == &filler_class || !obj->marked) {
+                continue;
+            }
+
+            for (int i = 0; i < obj->clss->num_fields; ++i) {
+                object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+                if ((void *) *field >= old) {
+                    *field = (*field)->forwarding;
+                }
+            }
+        }
+    }
+
+    // 移动对象
+    memset(card_first + (old - heap) / CARD_SIZE, -1, (num_cards - (old - heap) / CARD_SIZE) * sizeof(int));
+
+    void* p = old;
+    while (p < old_top) {
+        object* obj = (object *) p;
+        int size = obj->clss->size;
+
+        if (obj->clss != &filler_class && obj->marked) {
+            object* forwarding = obj->forwarding;
+            memmove(forwarding, obj, size);
+            forwarding->marked = FALSE;
+            forwarding->forwarding = NULL;
+            record_object_start(forwarding);
+        }
+
+        p += size;
+    }
+
+    printf("collection %d bytes\n", (int) (old_top - scan));
+    old_top = scan;
+
+    rebuild_remembered();
+}
+
+/**
+ * @brief 老年代压缩之后重新建立记录集
+ *  1. 对象移动之后记录集/卡片/slot都失效了，重新搜索老年代中引用新生代对象的对象
+ * 
+ */
+void rebuild_remembered() {
+    _rsp = 0;
+    memset(card_table, CARD_CLEAN, num_cards);
+    memset(slot_set, 0, slot_set_capacity * sizeof(object **));
+    slot_set_count = 0;
+    for (int i = 0; i < num_ssb_buffers; ++i) {
+        ssb_buffers[i]->top = 0;
+    }
+
+    for (void* p = old; p < old_top; p += ((object *) p)->clss->size) {
+        object* obj = (object *) p;
+        if (obj->clss == &filler_class) {
+            continue;
+        }
+
+        obj->remembered = FALSE;
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            if (is_young(*(object **) ((void *) obj + obj->clss->field_offsets[i]))) {
+                remember(obj);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 老年代清除
+ *  1. 按地址顺序遍历所有单元，回收的单元放回free-list的头部
+ * 
+ */
+void old_sweep() {
+    for (int i = 0; i < old_size / NODE_SIZE; ++i) {
+        node* _cur = (node *) (i * NODE_SIZE + old);
+        if (!_cur->used) continue;
+        object* obj = _cur->data;
+
+        if (obj->marked) {
+            obj->marked = FALSE;
+        } else {
+            // 回收的对象不能留在记录集中
+            if (obj->remembered) {
+                for (int j = 0; j < _rsp; ++j) {
+                    if (_rs[j] == obj) {
+                        _rs[j] = _rs[--_rsp];
+                        _rs[_rsp] = NULL;
+                        break;
+                    }
+                }
+            }
+
+            // 回收对象所属的node
+            memset(obj, 0, obj->clss->size);
+
+            _cur->used = FALSE;
+            _cur->data = NULL;
+            _cur->size = 0;
+
+            // 放回free-list
+            _cur->next = old_head;
+            old_head = _cur;
+            old_free_nodes++;
+            printf("collection ...\n");
+        }
+    }
+}
+
+/**
+ * @brief 标记-清除的老年代收集器
+ *  1. 老年区按NODE_SIZE划分单元，free-list只链接空闲单元，分配和释放都是O(1)
+ *  2. 对象不会移动，回收后的单元直接放回free-list
+ * 
+ */
+old_collector mark_sweep_collector = {
+    "mark-sweep",
+    ms_init,
+    ms_alloc,
+    ms_undo,
+    ms_retire,
+    ms_promotable_bytes,
+    ms_reclaim,
+    ms_used_bytes,
+    ms_visit_card,
+    ms_contains_slot,
+    ms_max_object_size
+};
+
+void ms_init() {
+    old_free_nodes = old_size / NODE_SIZE;
+    old_head = old_init_free_list(old_free_nodes);
+}
+
+/**
+ * @brief 从free-list的头部取出一个单元
+ *  1. 新生代GC之前已经保证了空闲单元足够，这里分配失败说明老年代GC之后也放不下
+ * 
+ * @param w 
+ * @param size 
+ * @return object* 
+ */
+object* ms_alloc(gc_worker* w, int size) {
+    if (size > NODE_SIZE - (int) sizeof(node)) {
+        printf("[Old]Object is too large for a free-list node!\n");
+        abort();
+    }
+
+    pthread_mutex_lock(&old_lock);
+    node* _node = old_head;
+    if (!_node) {
+        printf("[Old]Promotion Failed! OutOfMemory...\n");
+        abort();
+    }
+    old_head = _node->next;
+    old_free_nodes--;
+
+    // 将新对象分配在free-list的节点数据之后，node单元的空间除了sizeof(node), 剩下的地址空间都用于存储对象
+    _node->used = TRUE;
+    _node->data = (void *) _node + sizeof(node);
+    _node->size = size;
+    pthread_mutex_unlock(&old_lock);
+
+    return _node->data;
+}
+
+void ms_undo(gc_worker* w, object* obj) {
+    pthread_mutex_lock(&old_lock);
+    node* _node = (node *) ((void *) obj - sizeof(node));
+    _node->used = FALSE;
+    _node->data = NULL;
+    _node->size = 0;
+    _node->next = old_head;
+    old_head = _node;
+    old_free_nodes++;
+    pthread_mutex_unlock(&old_lock);
+}
+
+void ms_retire(gc_worker* w) {}
+
+/**
+ * @brief 每个对象占用一个单元，最坏情况下每个单元只放一个最小的对象
+ * 
+ * @return int 
+ */
+int ms_promotable_bytes() {
+    return old_free_nodes * (int) sizeof(object);
+}
+
+void ms_reclaim() {
+    old_sweep();
+
+    // 回收的对象中的域不能留在slot记录集中
+    if (gc_rs_mode == RS_SSB) {
+        slot_set_rebuild(FALSE);
+    }
+}
+
+int ms_used_bytes() {
+    return (old_size / NODE_SIZE - old_free_nodes) * NODE_SIZE;
+}
+
+/**
+ * @brief 每个单元只放一个对象，单元头之后的空间就是对象的上限
+ * 
+ * @return int 
+ */
+int ms_max_object_size() {
+    return NODE_SIZE - (int) sizeof(node);
+}
+
+void ms_visit_card(int card, void (*visitor)(object* obj, int card)) {
+    // 对象位于node之后，找出对象头落在卡片中的node
+    int card_start = card * CARD_SIZE - (old - heap) - sizeof(node);
+    int first = card_start <= 0 ? 0 : (card_start + NODE_SIZE - 1) / NODE_SIZE;
+
+    for (int i = first; i * NODE_SIZE < card_start + CARD_SIZE && i * NODE_SIZE < old_size; ++i) {
+        node* _node = (node *) (i * NODE_SIZE + old);
+        if (_node->used) {
+            visitor(_node->data, card);
+        }
+    }
+}
+
+/**
+ * @brief 对象所在的node可以直接由地址计算出来
+ * 
+ * @param slot 
+ * @return byte 
+ */
+byte ms_contains_slot(object** slot) {
+    if ((void *) slot < old || (void *) slot >= old + old_size) {
+        return FALSE;
+    }
+
+    node* _node = (node *) (((void *) slot - old) / NODE_SIZE * NODE_SIZE + old);
+    return _node->used && (void *) slot >= (void *) _node->data;
+}
+
+/**
+ * @brief 标记-压缩的老年代收集器
+ *  1. 晋升的对象在PLAB中顺序分配，不限制对象大小
+ *  2. 老年代GC时用Lisp2算法压缩，消除碎片之后仍然可以顺序分配
+ * 
+ */
+old_collector mark_compact_collector = {
+    "mark-compact",
+    mc_init,
+    mc_alloc,
+    mc_undo,
+    mc_retire,
+    mc_promotable_bytes,
+    mc_reclaim,
+    mc_used_bytes,
+    mc_visit_card,
+    mc_contains_slot,
+    mc_max_object_size
+};
+
+void mc_init() {
+    old_head = NULL;
+    old_free_nodes = 0;
+    old_top = old;
+    plab_top = NULL;
+    plab_end = NULL;
+}
+
+/**
+ * @brief 在PLAB中晋升
+ *  1. 并行新生代GC时在线程本地的PLAB中分配，PLAB用完时加锁切出新的PLAB
+ * 
+ * @param w 
+ * @param size 
+ * @return object* 
+ */
+object* mc_alloc(gc_worker* w, int size) {
+    if (!w) {
+        return plab_malloc(size);
+    }
+
+    if (w->plab_top && w->plab_top + size <= w->plab_end) {
+        object* new_obj = (object *) w->plab_top;
+        w->plab_top += size;
+        record_object_start(new_obj);
+        return new_obj;
+    }
+
+    // 借用单线程的PLAB切出新的PLAB
+    pthread_mutex_lock(&old_lock);
+    plab_top = w->plab_top;
+    plab_end = w->plab_end;
+    object* new_obj = plab_malloc(size);
+    w->plab_top = plab_top;
+    w->plab_end = plab_end;
+    plab_top = NULL;
+    plab_end = NULL;
+    pthread_mutex_unlock(&old_lock);
+
+    return new_obj;
+}
+
+void mc_undo(gc_worker* w, object* obj) {
+    int size = obj->clss->size;
+
+    if ((void *) obj + size == w->plab_top) {
+        w->plab_top = obj;
+    } else {
+        fill(obj, (void *) obj + size);
+    }
+}
+
+void mc_retire(gc_worker* w) {
+    if (!w) {
+        plab_retire();
+        return;
+    }
+
+    plab_top = w->plab_top;
+    plab_end = w->plab_end;
+    plab_retire();
+    w->plab_top = NULL;
+    w->plab_end = NULL;
+}
+
+/**
+ * @brief 最坏情况下每个线程还要浪费一个PLAB的剩余空间
+ * 
+ * @return int 
+ */
+int mc_promotable_bytes() {
+    return old + old_size - old_top - PLAB_SIZE * parallel_workers;
+}
+
+void mc_reclaim() {
+    old_compact();
+}
+
+int mc_used_bytes() {
+    return old_top - old;
+}
+
+int mc_max_object_size() {
+    return old_size;
+}
+
+void mc_visit_card(int card, void (*visitor)(object* obj, int card)) {
+    if (card_first[card] < 0) {
+        return;
+    }
+
+    // 从卡片中第一个对象开始逐个遍历，跳过filler和还没有使用的PLAB空间
+    void* card_end = heap + (card + 1) * CARD_SIZE;
+    void* p = heap + card_first[card];
+
+    while (p < card_end && p < old_top) {
+        if (p == plab_top) {
+            p = plab_end;
+            continue;
+        }
+
+        object* obj = (object *) p;
+        if (obj->clss != &filler_class) {
+            visitor(obj, card);
+        }
+        p += obj->clss->size;
+    }
+}
+
+/**
+ * @brief 只有老年代压缩会回收对象，压缩之后会重新建立记录集
+ * 
+ * @param slot 
+ * @return byte 
+ */
+byte mc_contains_slot(object** slot) {
+    return (void *) slot >= old && (void *) slot < old_top;
+}
+
+/**
+ * @brief 获取GC状态
+ * 
+ * @return char* 
+ */
+char* gc_get_state() {
     printf("Heap Usage:\n");
     printf("New Generation\n");
     printf("Eden Space:\n");
@@ -554,14 +2123,12 @@ char* gc_get_state() {
     printf("   used     = %d\n",0);
     printf("   free     = %d\n",survivor_size);
     printf("   %g%% used\n", 0);
+    printf("Tenuring threshold = %d\n", tenuring_threshold);
     printf("Old Generation\n");
 
-    int old_used = 0;
-    for (node* _n = old_head; _n; _n = _n->next) {
-        if (_n->used) {
-            old_used += NODE_SIZE;
-        }
-    }
+    printf("   collector = %s\n", old_gen->name);
+
+    int old_used = old_gen->used_bytes();
 
     printf("   capacity = %d\n", old_size);
     printf("   used     = %d\n", old_used);
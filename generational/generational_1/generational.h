@@ -3,6 +3,8 @@
 
 #endif
 
+#include <pthread.h>
+
 // 1字节的byte类型，用来做标识位
 typedef unsigned char byte;
 
@@ -12,6 +14,10 @@ typedef struct class_descriptor {
     int size;           // 类大小，即对应sizeof(struct)
     int num_fields;     // 属性数量
     int* field_offsets; // 类中的属性偏移，即所有属性在struct中偏移量(字节)
+    int allocated;      // 上次新生代GC之后在eden中分配的对象数
+    int sampled;        // 在eden中分配、已经经历过新生代GC的对象数
+    int survived;       // 在eden中分配、第一次新生代GC后还活着的对象数
+    byte pretenured;    // 是否直接在老年代中分配
 } class_descriptor;
 
 /**
@@ -55,8 +61,113 @@ struct _node {
 
 #define SURVIVOR_RATIO 8 // 新生代中Eden和from/to区配比，8代表Eden:From:To=8:1:1
 
+#define TARGET_SURVIVOR_RATIO 50 // 自适应调整时，期望GC后幸存空间的使用率(%)
+
+#define MIN_SURVIVOR_FRACTION 20 // 自适应调整时，幸存空间最小为新生代的1/20
+
+#define MAX_SURVIVOR_FRACTION 4  // 自适应调整时，幸存空间最大为新生代的1/4
+
 #define NODE_SIZE 128    // free-list单元大小(B)
 
+#define MAX_CLASSES 64   // 一次新生代GC之间最多统计多少个类的存活率
+
+#define PRETENURE_MIN_SAMPLES 64    // 类的采样对象数达到该值才判断是否直接在老年代中分配
+
+#define PRETENURE_SURVIVAL_RATIO 90 // 第一次新生代GC后存活的比例(%)达到该值的类直接在老年代中分配
+
+#define CARD_SIZE 128    // 卡片大小(B)
+
+#define CARD_CLEAN 0     // 卡片中没有指向新生代的引用
+
+#define CARD_DIRTY 1     // 卡片中可能有指向新生代的引用
+
+/**
+ * @brief 记录老年代到新生代引用的方法
+ * 
+ */
+typedef enum {
+    RS_OBJECT,  // 记录集，记录发出引用的老年代对象，最多MAX_ROOTS个
+    RS_CARD,    // 卡片标记，写入屏障只在卡片表格中设置标志位，不会溢出
+    RS_SSB      // 顺序存储缓冲区，写入屏障只追加被修改的域的地址，GC时去重
+} rs_mode;
+
+#define PLAB_SIZE 256    // 晋升本地分配缓冲区(promotion-local allocation buffer)大小(B)
+
+/**
+ * @brief 老年代的分配方法，对应内置的两种老年代收集器
+ * 
+ */
+typedef enum {
+    PROMOTE_FREE_LIST,  // mark_sweep_collector：每个晋升对象占用一个NODE_SIZE的free-list单元
+    PROMOTE_BUMP        // mark_compact_collector：晋升对象在PLAB中连续地顺序分配，不限制对象大小
+} promotion_mode;
+
+/**
+ * @brief 老年代收集器
+ *  1. 晋升时的分配、老年代GC的回收和老年代对象的遍历都通过这组函数完成
+ *  2. 标记阶段是共通的，从所有GC ROOTS出发经过新生代对象标记，收集器只负责回收没有标记的对象
+ *  3. w为NULL时是单线程的新生代GC，否则是并行新生代GC的线程
+ * 
+ */
+typedef struct _gc_worker gc_worker;
+typedef struct old_collector {
+    char* name;
+    void (*init)();                                 // gc_init时初始化老年代
+    object* (*alloc)(gc_worker* w, int size);       // 为晋升的对象分配空间，放不下时终止
+    void (*undo)(gc_worker* w, object* obj);        // 撤销并行新生代GC中没有抢到forwarding指针的晋升
+    void (*retire)(gc_worker* w);                   // 新生代GC结束时归还线程本地的缓冲区
+    int (*promotable_bytes)();                      // 最坏情况下还能容纳多少字节的晋升对象
+    void (*reclaim)();                              // 标记之后回收老年代
+    int (*used_bytes)();                            // 老年代已经使用的大小
+    void (*visit_card)(int card, void (*visitor)(object* obj, int card)); // 遍历对象头位于卡片中的所有对象
+    byte (*contains_slot)(object** slot);           // 域是否位于一个使用中的老年代对象中
+    int (*max_object_size)();                       // 能容纳的最大对象，更大的对象只能留在新生代
+} old_collector;
+
+// free-list + 标记-清除，对象大小不能超过NODE_SIZE
+extern old_collector mark_sweep_collector;
+
+// 顺序分配 + PLAB + 标记-压缩
+extern old_collector mark_compact_collector;
+
+#define MAX_WORKERS 16       // 并行新生代GC的最大线程数
+
+#define SURVIVOR_LAB_SIZE 128 // 并行新生代GC时每个线程一次从幸存空间中领取的缓冲区大小(B)
+
+/**
+ * @brief 并行新生代GC的线程
+ *  1. 每个线程有自己的灰色对象双端队列，自己从底部存取，其他线程从顶部窃取
+ *  2. 复制和晋升都在线程本地的缓冲区中顺序分配，不需要每个对象都同步
+ * 
+ */
+struct _gc_worker {
+    object** deque;         // 灰色对象双端队列
+    int top;                // 窃取的位置
+    int bottom;             // 自己存取的位置
+    int capacity;
+    pthread_mutex_t lock;
+    void* lab_top;          // 幸存空间缓冲区的下一个空闲位置
+    void* lab_end;
+    void* plab_top;         // PLAB的下一个空闲位置
+    void* plab_end;
+};
+
+#define SSB_SIZE 64      // 每个线程的顺序存储缓冲区容量，满了就倒入记录集
+
+#define MAX_THREADS 16   // 最多可以使用写入屏障的线程数
+
+/**
+ * @brief 顺序存储缓冲区(sequential store buffer)
+ *  1. 每个线程一个，写入屏障只需要把域的地址追加到末尾
+ *  2. 缓冲区满了或者新生代GC时，把其中指向新生代的老年代域去重后加入slot记录集
+ * 
+ */
+typedef struct _ssb_buffer ssb_buffer;
+struct _ssb_buffer {
+    object** slots[SSB_SIZE];   // 被修改的域的地址
+    int top;                    // 下一个空闲位置
+};
+
 const static byte TRUE = 1;
 const static byte FALSE = 0;
 
@@ -79,9 +190,27 @@ extern object* _rs[MAX_ROOTS];
 extern int _rp;
 extern int _rsp;
 
+/**
+ * @brief 卡片表格
+ *  1. 把整个堆按CARD_SIZE分割成卡片，每张卡片对应一个字节的标志位
+ *  2. 覆盖整个堆是为了让写入屏障不需要判断发出引用的对象在哪一代，新生代的卡片在GC时直接忽略
+ * 
+ */
+extern byte* card_table;
+
+// 注册了顺序存储缓冲区的线程数，线程退出时减少
+extern int num_ssb_buffers;
+
 // 堆总大小
 extern int heap_size;
 
+// eden区容量和survivor区容量，自适应调整时会在运行中变化
+extern int eden_size;
+extern int survivor_size;
+
+// 晋升年龄，对象年龄达到该值就晋升，自适应调整时会在1到MAX_AGE之间变化
+extern int tenuring_threshold;
+
 /**
  * @brief 初始化GC
  * 
@@ -89,6 +218,59 @@ extern int heap_size;
  */
 extern void gc_init(int size);
 
+/**
+ * @brief 设置记录老年代到新生代引用的方法，需要在gc_init之前调用
+ * 
+ * @param mode 
+ */
+extern void gc_set_rs_mode(rs_mode mode);
+
+/**
+ * @brief 设置老年代的分配方法，需要在gc_init之前调用
+ * 
+ * @param mode 
+ */
+extern void gc_set_promotion_mode(promotion_mode mode);
+
+/**
+ * @brief 设置老年代收集器，需要在gc_init之前调用
+ * 
+ * @param collector 
+ */
+extern void gc_set_old_collector(old_collector* collector);
+
+/**
+ * @brief 设置并行新生代GC的线程数，1表示不并行
+ * 
+ * @param n 线程数，不超过MAX_WORKERS
+ */
+extern void gc_set_parallel_workers(int n);
+
+/**
+ * @brief 设置是否根据每次新生代GC的结果调整晋升年龄和eden/survivor的大小
+ * 
+ * @param enable 
+ */
+extern void gc_set_adaptive_sizing(byte enable);
+
+/**
+ * @brief 设置是否根据每个类的存活率直接在老年代中分配(pretenuring)
+ *  1. 在eden中分配的对象第一次新生代GC后几乎都还活着的类，之后直接在老年代中分配，不再反复复制
+ *  2. 直接在老年代中分配的对象，初始化域时也要使用gc_update_ptr，否则写入屏障无法记录它引用的新生代对象
+ * 
+ * @param enable 
+ */
+extern void gc_set_pretenuring(byte enable);
+
+/**
+ * @brief 设置直接在老年代中分配的对象大小，0表示不限制
+ *  1. 不小于该大小的对象跳过eden，直接在老年代中分配
+ *  2. free-list的老年代放不下超过单元大小的对象
+ * 
+ * @param size 
+ */
+extern void gc_set_pretenure_size(int size);
+
 /**
  * @brief 执行GC
  * 
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <pthread.h>
 #include "generational.h"
 
 #define MAX_ROOTS 100
@@ -43,6 +44,69 @@ class_descriptor dept_object_class = {
     NULL
 };
 
+typedef struct big {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在rs中的标识
+    object* forwarding;     // 目标位置
+    int age;                // 对象年龄
+    int id;
+    emp* emp;
+    char payload[160];
+} big;
+
+class_descriptor big_object_class = {
+    "big_object",
+    sizeof(struct big),
+    1,
+    (int[]) {
+        offsetof(struct big, emp)
+    }
+};
+
+typedef struct link {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在rs中的标识
+    object* forwarding;     // 目标位置
+    int age;                // 对象年龄
+    int id;
+    struct link* next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
+typedef struct holder {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在rs中的标识
+    object* forwarding;     // 目标位置
+    int age;                // 对象年龄
+    int id;
+    struct holder* next;
+    dept* dept;
+} holder;
+
+class_descriptor holder_object_class = {
+    "holder_object",
+    sizeof(struct holder),
+    2,
+    (int[]) {
+        offsetof(struct holder, next),
+        offsetof(struct holder, dept)
+    }
+};
+
 // 测试新生代GC
 void test_minor_gc(){
     gc_init(2000);  // 分配后，实际可用1936
@@ -52,7 +116,7 @@ void test_minor_gc(){
 
     dept* _dept1 = (dept*) gc_alloc(&dept_object_class);
 
-    // 增加此引用会导致suivivor容量不足，复制失败
+    // 增加此引用会导致suivivor容量不足，放不下的对象提前晋升
     gc_update_ptr((object *)_emp1, (object**)&_emp1->dept, (object*)_dept1);
 
     for (int i = 0; i < 6; ++i) {
@@ -61,9 +125,14 @@ void test_minor_gc(){
 
     printf("即将新生代GC\n");
 
-    // suivivor容量不足，复制失败
+    // suivivor容量不足，dept1提前晋升
     emp* temp_emp = (emp *) gc_alloc(&emp_object_class);
 
+    if ((void *) ((emp *) _roots[0])->dept < (void *) ((emp *) _roots[0]) || ((emp *) _roots[0])->dept->clss != &dept_object_class) {
+        printf("premature promotion failed!\n");
+        abort();
+    }
+
     gc_get_state();
 }
 
@@ -184,8 +253,543 @@ void test_promotion_cross_gen_ref_gc(){
     gc_get_state();
 }
 
+// 测试卡片标记记录的跨代引用
+void test_card_table(){
+    printf("test_card_table\n");
+    gc_set_rs_mode(RS_CARD);
+    gc_init(2000);  // 分配后，实际可用1936
+
+    emp *_emp1 = (emp *) gc_alloc(&emp_object_class);
+    gc_add_root(_emp1);
+
+    // 触发3次新生代GC，然后emp1会晋升至老年代
+    for (int i = 0; i < 32; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    // 老年代的emp1引用新生代的dept1，写入屏障只设置卡片的标志位
+    dept *dept1 = (dept *) gc_alloc(&dept_object_class);
+    dept1->id = 666;
+    gc_update_ptr(_roots[0], (object **)&((emp*)_roots[0])->dept, (object*)dept1);
+
+    // dept1只被老年代引用，要经过多次新生代GC存活下来并晋升
+    for (int i = 0; i < 40; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    dept* ref = ((emp*)_roots[0])->dept;
+    if (!ref || ref->id != 666) {
+        printf("card table lost cross-generation reference!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_rs_mode(RS_OBJECT);
+}
+
+// 测试顺序存储缓冲区记录的跨代引用
+void test_ssb(){
+    printf("test_ssb\n");
+    gc_set_rs_mode(RS_SSB);
+    gc_init(2000);  // 分配后，实际可用1936
+
+    emp *_emp1 = (emp *) gc_alloc(&emp_object_class);
+    gc_add_root(_emp1);
+
+    // 触发3次新生代GC，然后emp1会晋升至老年代
+    for (int i = 0; i < 32; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    // 反复修改同一个域，缓冲区会多次倒空，记录集中只有一条记录
+    dept *dept1 = (dept *) gc_alloc(&dept_object_class);
+    dept1->id = 666;
+    for (int i = 0; i < SSB_SIZE * 3; ++i) {
+        gc_update_ptr(_roots[0], (object **)&((emp*)_roots[0])->dept, i % 2 ? NULL : (object*)dept1);
+    }
+    gc_update_ptr(_roots[0], (object **)&((emp*)_roots[0])->dept, (object*)dept1);
+
+    // dept1只被老年代引用，要经过多次新生代GC存活下来并晋升
+    for (int i = 0; i < 40; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    dept* ref = ((emp*)_roots[0])->dept;
+    if (!ref || ref->id != 666) {
+        printf("ssb lost cross-generation reference!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_rs_mode(RS_OBJECT);
+}
+
+#define SSB_THREADS 4
+#define SSB_HOLDERS 128
+
+holder* ssb_holders[SSB_HOLDERS];
+dept* ssb_depts[SSB_HOLDERS];
+
+// 每个线程反复修改一部分老年代对象的域，最后都指向对应的新生代对象
+void* ssb_mutator(void* arg) {
+    long t = (long) arg;
+    for (int round = 0; round < 50; ++round) {
+        for (int i = t; i < SSB_HOLDERS; i += SSB_THREADS) {
+            holder* h = ssb_holders[i];
+            gc_update_ptr((object *) h, (object **) &h->dept, round % 2 ? NULL : (object *) ssb_depts[i]);
+        }
+    }
+    for (int i = t; i < SSB_HOLDERS; i += SSB_THREADS) {
+        holder* h = ssb_holders[i];
+        gc_update_ptr((object *) h, (object **) &h->dept, (object *) ssb_depts[i]);
+    }
+
+    return NULL;
+}
+
+// 测试多个线程同时倒空顺序存储缓冲区，线程退出时缓冲区中剩下的域也要加入记录集
+void test_ssb_threads(){
+    printf("test_ssb_threads\n");
+    gc_set_rs_mode(RS_SSB);
+    gc_init(100000);
+
+    holder* head = NULL;
+    for (int i = SSB_HOLDERS - 1; i >= 0; --i) {
+        holder* h = (holder *) gc_alloc(&holder_object_class);
+        h->id = i;
+        h->next = head;
+        head = h;
+    }
+    gc_add_root(head);
+
+    // holder全部晋升至老年代
+    for (int i = 0; i < 2000; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    // 新生代的dept只被老年代的holder引用，分配时可能发生新生代GC，先通过写入屏障记录下来
+    int i = 0;
+    for (holder* h = (holder *) _roots[0]; h; h = h->next) {
+        ssb_holders[i++] = h;
+    }
+    for (i = 0; i < SSB_HOLDERS; ++i) {
+        dept* d = (dept *) gc_alloc(&dept_object_class);
+        d->id = i;
+        gc_update_ptr((object *) ssb_holders[i], (object **) &ssb_holders[i]->dept, (object *) d);
+    }
+
+    // 新生代GC会移动dept，全部分配完之后再取出
+    for (i = 0; i < SSB_HOLDERS; ++i) {
+        ssb_depts[i] = ssb_holders[i]->dept;
+    }
+
+    int before = num_ssb_buffers;
+    pthread_t threads[SSB_THREADS];
+    for (long t = 0; t < SSB_THREADS; ++t) {
+        pthread_create(&threads[t], NULL, ssb_mutator, (void *) t);
+    }
+    for (int t = 0; t < SSB_THREADS; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    if (num_ssb_buffers != before) {
+        printf("ssb buffers of exited threads are not unregistered!\n");
+        abort();
+    }
+
+    // dept只被老年代引用，要经过多次新生代GC存活下来
+    for (i = 0; i < 2000; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    i = 0;
+    for (holder* h = (holder *) _roots[0]; h; h = h->next, ++i) {
+        if (h->id != i || !h->dept || h->dept->id != i) {
+            printf("ssb lost cross-generation reference!\n");
+            abort();
+        }
+    }
+
+    gc_get_state();
+    gc_set_rs_mode(RS_OBJECT);
+}
+
+// 长期存活的对象 + 8个轮换的根，对象晋升后不久就变成老年代垃圾，最后检查对象的内容
+void ring_workload(int rounds, byte big_object) {
+    if (big_object) {
+        // 超过NODE_SIZE的对象，只有顺序分配的老年代能容纳
+        big* _big = (big *) gc_alloc(&big_object_class);
+        memset(_big->payload, 'x', sizeof(_big->payload));
+        gc_add_root(_big);
+
+        emp* _emp = (emp *) gc_alloc(&emp_object_class);
+        _emp->id = 666;
+        gc_update_ptr(_roots[0], (object **)&((big *)_roots[0])->emp, (object *)_emp);
+    } else {
+        emp* _emp = (emp *) gc_alloc(&emp_object_class);
+        _emp->id = 666;
+        gc_add_root(_emp);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        gc_add_root(NULL);
+    }
+
+    for (int j = 0; j < rounds; ++j) {
+        emp* e = (emp *) gc_alloc(&emp_object_class);
+        e->id = j;
+        _roots[j % 8 + 1] = (object *) e;
+
+        dept* d = (dept *) gc_alloc(&dept_object_class);
+        d->id = j;
+        gc_update_ptr(_roots[j % 8 + 1], (object **)&((emp *)_roots[j % 8 + 1])->dept, (object *)d);
+
+        for (int i = 0; i < 80; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+    }
+
+    big* ref = (big *) _roots[0];
+    if (big_object && (ref->payload[0] != 'x' || ref->payload[sizeof(ref->payload) - 1] != 'x' || ref->emp->id != 666)) {
+        printf("promoted object corrupted!\n");
+        abort();
+    }
+    if (!big_object && ((emp *) _roots[0])->id != 666) {
+        printf("promoted object corrupted!\n");
+        abort();
+    }
+
+    for (int j = rounds - 8; j < rounds; ++j) {
+        emp* e = (emp *) _roots[j % 8 + 1];
+        if (e->id != j || e->dept->id != j) {
+            printf("root object corrupted!\n");
+            abort();
+        }
+    }
+}
+
+// 测试PLAB顺序分配的晋升和老年代压缩
+void test_bump_promotion(){
+    rs_mode modes[3] = { RS_OBJECT, RS_CARD, RS_SSB };
+
+    for (int m = 0; m < 3; ++m) {
+        printf("test_bump_promotion rs_mode=%d\n", modes[m]);
+        gc_set_rs_mode(modes[m]);
+        gc_set_promotion_mode(PROMOTE_BUMP);
+        gc_init(40000);
+
+        ring_workload(2000, TRUE);
+
+        gc_get_state();
+    }
+
+    gc_set_rs_mode(RS_OBJECT);
+    gc_set_promotion_mode(PROMOTE_FREE_LIST);
+}
+
+// 测试并行新生代GC
+void test_parallel_minor_gc(){
+    rs_mode rs_modes[3] = { RS_OBJECT, RS_CARD, RS_SSB };
+    promotion_mode promotion_modes[2] = { PROMOTE_FREE_LIST, PROMOTE_BUMP };
+
+    gc_set_parallel_workers(4);
+
+    for (int p = 0; p < 2; ++p) {
+        for (int m = 0; m < 3; ++m) {
+            printf("test_parallel_minor_gc promotion_mode=%d rs_mode=%d\n", promotion_modes[p], rs_modes[m]);
+            gc_set_rs_mode(rs_modes[m]);
+            gc_set_promotion_mode(promotion_modes[p]);
+            gc_init(48000);  // 线程本地的幸存空间缓冲区会有一些浪费，幸存空间要大一些
+
+            ring_workload(2000, promotion_modes[p] == PROMOTE_BUMP);
+
+            gc_get_state();
+        }
+    }
+
+    gc_set_parallel_workers(1);
+    gc_set_rs_mode(RS_OBJECT);
+    gc_set_promotion_mode(PROMOTE_FREE_LIST);
+}
+
+// 检查链表的内容
+void check_links(link* head, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (!head || head->id != i) {
+            printf("link list corrupted!\n");
+            abort();
+        }
+        head = head->next;
+    }
+}
+
+// 测试广度优先的新生代GC
+void test_cheney(){
+    promotion_mode modes[2] = { PROMOTE_FREE_LIST, PROMOTE_BUMP };
+
+    for (int m = 0; m < 2; ++m) {
+        printf("test_cheney promotion_mode=%d\n", modes[m]);
+        gc_set_promotion_mode(modes[m]);
+        gc_init(100000);
+
+        // 从尾部开始创建链表，每个节点只被前一个节点引用
+        link* head = NULL;
+        for (int i = 39; i >= 0; --i) {
+            link* l = (link *) gc_alloc(&link_object_class);
+            l->id = i;
+            l->next = head;
+            head = l;
+        }
+        gc_add_root(head);
+
+        // 第一次新生代GC后，链表按广度优先的顺序连续地排列在幸存空间中
+        for (int i = 0; i < 400; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+
+        link* l = (link *) _roots[0];
+        for (int i = 0; i < 39; ++i, l = l->next) {
+            if ((void *) l->next != (void *) l + sizeof(link)) {
+                printf("link list is not copied breadth-first!\n");
+                abort();
+            }
+        }
+        check_links((link *) _roots[0], 40);
+
+        // 链表全部晋升之后，再在新生代中加一个节点
+        for (int i = 0; i < 2000; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+
+        link* tail = (link *) gc_alloc(&link_object_class);
+        tail->id = 40;
+        for (l = (link *) _roots[0]; l->next; l = l->next) {}
+        gc_update_ptr((object *) l, (object **) &l->next, (object *) tail);
+
+        for (int i = 0; i < 2000; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+        check_links((link *) _roots[0], 41);
+
+        gc_get_state();
+    }
+
+    gc_set_promotion_mode(PROMOTE_FREE_LIST);
+}
+
+// 测试自适应调整晋升年龄和幸存空间大小
+void test_adaptive_sizing(){
+    printf("test_adaptive_sizing\n");
+    gc_set_adaptive_sizing(TRUE);
+    gc_init(40000);
+
+    int initial_survivor_size = survivor_size;
+    int min_threshold = MAX_AGE;
+
+    // 30个轮换的根，存活的对象超过了默认的幸存空间，幸存空间变大，晋升年龄变小
+    for (int j = 0; j < 2000; ++j) {
+        emp* e = (emp *) gc_alloc(&emp_object_class);
+        e->id = j;
+        _roots[j % 30] = (object *) e;
+        _rp = _rp > j % 30 ? _rp : j % 30 + 1;
+
+        dept* d = (dept *) gc_alloc(&dept_object_class);
+        d->id = j;
+        gc_update_ptr(_roots[j % 30], (object **)&((emp *)_roots[j % 30])->dept, (object *)d);
+
+        for (int i = 0; i < 40; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+
+        min_threshold = tenuring_threshold < min_threshold ? tenuring_threshold : min_threshold;
+    }
+
+    for (int j = 1970; j < 2000; ++j) {
+        emp* e = (emp *) _roots[j % 30];
+        if (e->id != j || e->dept->id != j) {
+            printf("root object corrupted!\n");
+            abort();
+        }
+    }
+
+    int grown_survivor_size = survivor_size;
+    if (grown_survivor_size <= initial_survivor_size || min_threshold >= MAX_AGE) {
+        printf("survivor space is not grown!\n");
+        abort();
+    }
+
+    // 没有存活的对象时，幸存空间变小，晋升年龄回到MAX_AGE
+    _rp = 0;
+    for (int i = 0; i < 20000; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    if (survivor_size >= grown_survivor_size || tenuring_threshold != MAX_AGE) {
+        printf("survivor space is not shrunk!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_adaptive_sizing(FALSE);
+}
+
+// 测试老年代收集器：老年代GC从所有GC ROOTS出发，经过新生代对象标记
+void test_old_collector(){
+    old_collector* collectors[2] = { &mark_sweep_collector, &mark_compact_collector };
+
+    for (int c = 0; c < 2; ++c) {
+        printf("test_old_collector %s\n", collectors[c]->name);
+        gc_set_old_collector(collectors[c]);
+        gc_init(100000);
+
+        // 一个链表一直活着，另一个链表晋升之后变成垃圾
+        for (int r = 0; r < 2; ++r) {
+            link* head = NULL;
+            for (int i = 19; i >= 0; --i) {
+                link* l = (link *) gc_alloc(&link_object_class);
+                l->id = i;
+                l->next = head;
+                head = l;
+            }
+            gc_add_root(head);
+        }
+
+        for (int i = 0; i < 2000; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+
+        // 活着的链表只被一个新生代对象引用
+        link* holder = (link *) gc_alloc(&link_object_class);
+        holder->id = -1;
+        holder->next = (link *) _roots[0];
+        _roots[0] = (object *) holder;
+        _rp = 1;
+
+        gc();
+
+        check_links(((link *) _roots[0])->next, 20);
+
+        // 垃圾链表被回收，标记-压缩之后活动对象之间没有碎片
+        int expected = collectors[c] == &mark_compact_collector ? 20 * sizeof(link) : 20 * NODE_SIZE;
+        if (collectors[c]->used_bytes() != expected) {
+            printf("old generation used %d bytes, expected %d!\n", collectors[c]->used_bytes(), expected);
+            abort();
+        }
+
+        for (int i = 0; i < 2000; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+        check_links(((link *) _roots[0])->next, 20);
+
+        gc_get_state();
+    }
+
+    gc_set_promotion_mode(PROMOTE_FREE_LIST);
+}
+
+// 测试pretenuring：大对象和几乎总是存活的类直接在老年代中分配
+void test_pretenuring(){
+    printf("test_pretenuring\n");
+    gc_set_promotion_mode(PROMOTE_BUMP);
+    gc_set_pretenuring(TRUE);
+    gc_set_pretenure_size(sizeof(big));
+    gc_init(100000);
+
+    // 大对象跳过eden
+    big* b = (big *) gc_alloc(&big_object_class);
+    if (mark_compact_collector.used_bytes() == 0) {
+        printf("large object is allocated in eden!\n");
+        abort();
+    }
+    gc_add_root(b);
+
+    // 链表节点全部存活，emp全部是垃圾
+    int count = 0;
+    link* head = NULL;
+    gc_add_root(head);
+    for (int r = 0; r < 4; ++r) {
+        for (int i = 0; i < 30; ++i, ++count) {
+            link* l = (link *) gc_alloc(&link_object_class);
+            l->id = 120 - count;
+            gc_update_ptr((object *) l, (object **) &l->next, _roots[1]);
+            _roots[1] = (object *) l;
+        }
+
+        for (int i = 0; i < 2000; ++i) {
+            emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+        }
+    }
+
+    if (!link_object_class.pretenured || emp_object_class.pretenured) {
+        printf("pretenuring decision is wrong!\n");
+        abort();
+    }
+
+    // 之后分配的链表节点直接在老年代中，新生代GC不会移动它
+    link* l = (link *) gc_alloc(&link_object_class);
+    l->id = 0;
+    gc_update_ptr((object *) l, (object **) &l->next, _roots[1]);
+    _roots[1] = (object *) l;
+
+    for (int i = 0; i < 2000; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    if ((void *) _roots[0] != (void *) b || (void *) _roots[1] != (void *) l) {
+        printf("pretenured object is moved by minor gc!\n");
+        abort();
+    }
+    check_links((link *) _roots[1], 121);
+
+    gc_get_state();
+
+    gc_set_pretenuring(FALSE);
+    gc_set_pretenure_size(0);
+    gc_set_promotion_mode(PROMOTE_FREE_LIST);
+}
+
+// 测试默认的标记-清除老年代：放不进free-list单元的大对象不直接在老年代中分配，一直留在新生代
+void test_pretenuring_large_object(){
+    printf("test_pretenuring_large_object\n");
+    gc_set_old_collector(&mark_sweep_collector);
+    gc_set_pretenure_size(sizeof(big));
+    gc_init(100000);
+
+    big* b = (big *) gc_alloc(&big_object_class);
+    memset(b->payload, 'x', sizeof(b->payload));
+    gc_add_root(b);
+
+    // 经过多次新生代GC，超过晋升年龄之后也不会晋升
+    for (int i = 0; i < 4000; ++i) {
+        emp *temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+
+    b = (big *) _roots[0];
+    if (mark_sweep_collector.used_bytes() != 0) {
+        printf("large object is moved to the free-list old generation!\n");
+        abort();
+    }
+    if (b->payload[0] != 'x' || b->payload[sizeof(b->payload) - 1] != 'x') {
+        printf("large object corrupted!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_pretenure_size(0);
+}
+
 int main(int argc, char* argv[]) {
 
+    test_card_table();
+    test_ssb();
+    test_ssb_threads();
+    test_bump_promotion();
+    test_cheney();
+    test_parallel_minor_gc();
+    test_adaptive_sizing();
+    test_old_collector();
+    test_pretenuring();
+    test_pretenuring_large_object();
     test_minor_gc();
     // test_promotion();
     // test_promotion_old_gc();
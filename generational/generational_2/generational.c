@@ -0,0 +1,705 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "generational.h"
+
+object* _roots[MAX_ROOTS];
+
+int _rp;
+
+void* heap;     // 堆指针
+int heap_size;  // 堆容量
+
+int num_generations;                // 代数
+generation gens[MAX_GENERATIONS];   // 所有的代
+
+int evacuating;         // 本次GC中被复制的代数，比它年轻的代都会被复制
+
+object** promoted;      // 本次GC中晋升到没有被复制的代中的对象，和to空间中的对象一样是灰色对象
+int promoted_count;
+int promoted_capacity;
+
+object** remembered_roots;  // 记录集中来自没有被复制的代的对象，当作根
+int remembered_count;
+int remembered_capacity;
+
+object** mark_stack;    // 标记时的灰色对象
+int mark_sp;
+int mark_stack_capacity;
+
+int resolve_heap_size(int size);
+int select_generations();                   // 根据各代的使用率决定收集最年轻的几代
+void evacuate(int m);                       // 复制最年轻的m代
+object* gen_copy(object* obj);              // 复制对象，到达晋升年龄的晋升到下一代
+void scan_object(object* obj);              // 复制对象引用的对象并更新域，重新记录跨代引用
+void scavenge();                            // 广度优先地搜索复制和晋升的对象
+void remember(object* obj, int gen);        // 把对象记录到第gen代的记录集中
+void push_object(object*** list, int* count, int* capacity, object* obj);
+
+void mark_all();                            // 从所有GC ROOTS出发，标记所有代中的活动对象
+void mark_push(object* obj);
+
+void copying_init(generation* g);
+object* copying_alloc(generation* g, int size);
+int copying_used_bytes(generation* g);
+
+void mc_init(generation* g);
+object* mc_alloc(generation* g, int size);
+int mc_used_bytes(generation* g);
+void mc_collect(generation* g);
+
+/**
+ * @brief 复制收集器
+ *  1. 空间分成from/to两半，只在from中分配
+ *  2. 收集时活动对象被复制到to空间或者晋升到下一代，结束后交换from/to
+ * 
+ */
+gen_collector copying_collector = {
+    "copying",
+    copying_init,
+    copying_alloc,
+    copying_used_bytes,
+    NULL
+};
+
+/**
+ * @brief 标记-压缩收集器
+ *  1. 整个代都用来顺序分配，对象不会晋升
+ *  2. 收集时从所有GC ROOTS出发标记，经过比它年轻的代中的对象，然后用Lisp2算法压缩
+ * 
+ */
+gen_collector mark_compact_collector = {
+    "mark-compact",
+    mc_init,
+    mc_alloc,
+    mc_used_bytes,
+    mc_collect
+};
+
+/**
+ * @brief 堆数据分配
+ *  1. 按照各代的比重划分堆
+ * 
+ * @param size
+ * @return int
+ */
+int resolve_heap_size(int size) {
+    if (size > MAX_HEAP_SIZE) {
+        size = MAX_HEAP_SIZE;
+    }
+
+    int total_weight = 0;
+    for (int i = 0; i < num_generations; ++i) {
+        total_weight += gens[i].weight;
+    }
+
+    int total = 0;
+    for (int i = 0; i < num_generations; ++i) {
+        // 复制收集器的代要分成两半，按16字节对齐
+        gens[i].size = (int) ((long) size * gens[i].weight / total_weight) / 16 * 16;
+        total += gens[i].size;
+    }
+
+    return total;
+}
+
+/**
+ * @brief gc初始化
+ * 
+ * @param size
+ */
+void gc_init(int size) {
+    if (!num_generations) {
+        gc_set_generations(DEFAULT_GENERATIONS);
+    }
+
+    heap_size = resolve_heap_size(size);
+
+    // 分配
+    heap = malloc(heap_size);
+
+    void* start = heap;
+    for (int i = 0; i < num_generations; ++i) {
+        generation* g = &gens[i];
+        g->start = start;
+        g->top = 0;
+        g->to_top = 0;
+        g->scan = 0;
+        g->collecting = FALSE;
+        g->rsp = 0;
+        g->collections = 0;
+        g->promoted_bytes = 0;
+        g->collector->init(g);
+
+        start += g->size;
+    }
+
+    _rp = 0;
+}
+
+void gc_set_generations(int n) {
+    num_generations = n < 2 ? 2 : (n > MAX_GENERATIONS ? MAX_GENERATIONS : n);
+
+    for (int i = 0; i < num_generations; ++i) {
+        gens[i].collector = i == num_generations - 1 ? &mark_compact_collector : &copying_collector;
+        gens[i].weight = 1 << i;
+        gens[i].tenure_age = DEFAULT_TENURE_AGE;
+    }
+}
+
+void gc_set_generation(int gen, int weight, int tenure_age, gen_collector* collector) {
+    if (gen < 0 || gen >= num_generations) {
+        printf("[Gen %d]No such generation!\n", gen);
+        abort();
+    }
+
+    // 原地回收的代没有下一代可以晋升，年轻的代必须复制
+    if (collector->collect && gen != num_generations - 1) {
+        printf("[Gen %d]%s can only collect the oldest generation!\n", gen, collector->name);
+        abort();
+    }
+
+    gens[gen].weight = weight;
+    gens[gen].tenure_age = tenure_age;
+    gens[gen].collector = collector;
+}
+
+/**
+ * @brief GC结束，彻底清理堆
+ * 
+ */
+void gc_done() {
+    free(heap);
+    heap = NULL;
+
+    for (int i = 0; i < num_generations; ++i) {
+        free(gens[i].rs);
+        gens[i].rs = NULL;
+        gens[i].rsp = 0;
+        gens[i].rs_capacity = 0;
+    }
+}
+
+int gc_generation_of(object* obj) {
+    for (int i = 0; i < num_generations; ++i) {
+        if ((void *) obj >= gens[i].start && (void *) obj < gens[i].start + gens[i].size) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief 内存分配
+ *  1. 第0代放不下时，收集最年轻的几代
+ *  2. 还是放不下就收集所有的代
+ * 
+ * @param clss
+ * @return object*
+ */
+object* gc_alloc(class_descriptor* clss) {
+    object* new_obj = gens[0].collector->alloc(&gens[0], clss->size);
+
+    if (!new_obj) {
+        printf("[Gen 0]Allocation Failed. execute gc...\n");
+        gc_collect(select_generations());
+        new_obj = gens[0].collector->alloc(&gens[0], clss->size);
+    }
+
+    if (!new_obj) {
+        gc();
+        new_obj = gens[0].collector->alloc(&gens[0], clss->size);
+        if (!new_obj) {
+            printf("[Gen 0]Allocation Failed! OutOfMemory...\n");
+            abort();
+        }
+    }
+
+    // 初始化
+    new_obj->clss = clss;
+    new_obj->forwarded = FALSE;
+    new_obj->marked = FALSE;
+    new_obj->remembered = 0;
+    new_obj->age = 0;
+    new_obj->forwarding = NULL;
+
+    for (int i = 0; i < clss->num_fields; ++i) {
+        *(object **) ((void *) new_obj + clss->field_offsets[i]) = NULL;
+    }
+
+    return new_obj;
+}
+
+/**
+ * @brief 修改引用
+ *  1. 写入屏障：老的代中的对象引用了年轻的代中的对象时，记录到年轻的那一代的记录集中
+ * 
+ * @param obj
+ * @param field_ref
+ * @param new_obj
+ */
+void gc_update_ptr(object* obj, object** field_ref, object* new_obj) {
+    int src = gc_generation_of(obj);
+    int dst = gc_generation_of(new_obj);
+
+    if (dst >= 0 && dst < src) {
+        remember(obj, dst);
+    }
+
+    *field_ref = new_obj;
+}
+
+/**
+ * @brief 把对象记录到第gen代的记录集中
+ *  1. remembered的第gen位表示已经记录过，不会重复记录
+ * 
+ * @param obj
+ * @param gen
+ */
+void remember(object* obj, int gen) {
+    if (obj->remembered & (1 << gen)) {
+        return;
+    }
+
+    obj->remembered |= 1 << gen;
+    push_object(&gens[gen].rs, &gens[gen].rsp, &gens[gen].rs_capacity, obj);
+}
+
+void push_object(object*** list, int* count, int* capacity, object* obj) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *list = (object **) realloc(*list, *capacity * sizeof(object *));
+    }
+    (*list)[(*count)++] = obj;
+}
+
+/**
+ * @brief 根据各代的使用率决定收集最年轻的几代
+ *  1. 至少收集第0代
+ *  2. 晋升的目标代已经快满了，就把它也一起收集，依次类推
+ * 
+ * @return int
+ */
+int select_generations() {
+    int k = 1;
+    while (k < num_generations && gens[k].collector->used_bytes(&gens[k]) * 100 > gens[k].capacity * GEN_FULL_RATIO) {
+        k++;
+    }
+
+    return k;
+}
+
+void gc() {
+    gc_collect(num_generations);
+}
+
+/**
+ * @brief 收集最年轻的k代
+ *  1. 最老的那一代不复制时，先在原地回收它，再复制比它年轻的代
+ *  2. 被复制的代中的活动对象，复制到自己的to空间，或者到达晋升年龄后晋升到下一代
+ * 
+ * @param k
+ */
+void gc_collect(int k) {
+    if (k > num_generations) {
+        k = num_generations;
+    }
+
+    printf("collect youngest %d generations\n", k);
+
+    int m = k;
+    generation* oldest = &gens[k - 1];
+    if (oldest->collector->collect) {
+        oldest->collector->collect(oldest);
+        oldest->collections++;
+        m = k - 1;
+    }
+
+    if (m > 0) {
+        evacuate(m);
+    }
+}
+
+/**
+ * @brief 复制最年轻的m代
+ *  1. 被复制的代的记录集中，来自比m代老的代的对象当作根，然后清空这些记录集
+ *  2. 搜索对象时重新记录跨代引用，被复制的代的记录集在复制结束时就重新建立好了
+ *  3. 和Cheney算法一样，每个被复制的代的to空间中有自己的scan，晋升到没有被复制的代中的对象单独记录
+ * 
+ * @param m
+ */
+void evacuate(int m) {
+    evacuating = m;
+    byte mask = (1 << m) - 1;
+
+    remembered_count = 0;
+    for (int i = 0; i < m; ++i) {
+        generation* g = &gens[i];
+        g->collecting = TRUE;
+        g->to_top = 0;
+        g->scan = 0;
+
+        // from空间中的对象最坏情况下全部留在这一代，晋升过来的对象只能使用剩下的to空间
+        g->promote_room = g->capacity - g->top;
+
+        for (int j = 0; j < g->rsp; ++j) {
+            object* obj = g->rs[j];
+
+            // 比m代年轻的对象如果活着，会在复制时重新记录
+            if (gc_generation_of(obj) >= m && (obj->remembered & mask)) {
+                obj->remembered &= ~mask;
+                push_object(&remembered_roots, &remembered_count, &remembered_capacity, obj);
+            }
+        }
+        g->rsp = 0;
+    }
+
+    for (int i = 0; i < _rp; ++i) {
+        _roots[i] = gen_copy(_roots[i]);
+    }
+
+    for (int i = 0; i < remembered_count; ++i) {
+        scan_object(remembered_roots[i]);
+    }
+
+    scavenge();
+
+    for (int i = 0; i < m; ++i) {
+        generation* g = &gens[i];
+
+        void* from = g->from;
+        g->from = g->to;
+        g->to = from;
+        g->top = g->to_top;
+        g->collecting = FALSE;
+        g->collections++;
+
+        memset(g->to, 0, g->capacity);
+    }
+}
+
+/**
+ * @brief 复制对象
+ *  1. 不在被复制的代中的对象、已经在to空间中的对象不需要复制
+ *  2. 在这一代中的年龄达到晋升年龄后晋升到下一代，下一代放不下时留在这一代
+ *  3. 下一代也在被复制时，晋升对象不能超过它的promote_room，否则会挤占它自己的幸存对象的位置
+ * 
+ * @param obj
+ * @return object* 复制后的对象指针
+ */
+object* gen_copy(object* obj) {
+    int gen = gc_generation_of(obj);
+    if (gen < 0 || gen >= evacuating) {
+        return obj;
+    }
+
+    generation* g = &gens[gen];
+    if ((void *) obj >= g->to && (void *) obj < g->to + g->capacity) {
+        return obj;
+    }
+
+    if (obj->forwarded) {
+        return obj->forwarding;
+    }
+
+    int size = obj->clss->size;
+    int dest = gen;
+    object* copy = NULL;
+
+    if (obj->age + 1 >= g->tenure_age && gen + 1 < num_generations) {
+        generation* next = &gens[gen + 1];
+        if (!next->collecting || next->promote_room >= size) {
+            copy = next->collector->alloc(next, size);
+        }
+        if (copy) {
+            dest = gen + 1;
+            if (next->collecting) {
+                next->promote_room -= size;
+            }
+        }
+    }
+
+    // 晋升过来的对象不超过promote_room，to空间一定放得下from空间中的幸存对象
+    if (!copy) {
+        copy = g->collector->alloc(g, size);
+    }
+    if (!copy) {
+        printf("[Gen %d]Copy Failed! OutOfMemory...\n", gen);
+        abort();
+    }
+
+    memcpy(copy, obj, size);
+    copy->age = dest == gen ? obj->age + 1 : 0;
+    copy->forwarded = FALSE;
+    copy->marked = FALSE;
+    copy->remembered = 0;
+    copy->forwarding = NULL;
+
+    obj->forwarded = TRUE;
+    obj->forwarding = copy;
+
+    if (dest != gen) {
+        gens[dest].promoted_bytes += size;
+    }
+
+    // 晋升到没有被复制的代中的对象不在to空间中，单独记录
+    if (dest >= evacuating) {
+        push_object(&promoted, &promoted_count, &promoted_capacity, copy);
+    }
+
+    return copy;
+}
+
+/**
+ * @brief 复制对象引用的对象并更新域
+ *  1. 更新后还引用着比它年轻的代中的对象时，记录到那一代的记录集中
+ * 
+ * @param obj
+ */
+void scan_object(object* obj) {
+    int gen = gc_generation_of(obj);
+
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+        if (!*field) {
+            continue;
+        }
+
+        *field = gen_copy(*field);
+
+        int ref_gen = gc_generation_of(*field);
+        if (ref_gen >= 0 && ref_gen < gen) {
+            remember(obj, ref_gen);
+        }
+    }
+}
+
+/**
+ * @brief 广度优先地搜索复制和晋升的对象
+ *  1. 所有to空间中scan之后的对象和晋升列表中的对象都是灰色对象
+ *  2. 都没有灰色对象时结束
+ * 
+ */
+void scavenge() {
+    int promoted_scan = 0;
+    byte grey = TRUE;
+
+    while (grey) {
+        grey = FALSE;
+
+        for (int i = 0; i < evacuating; ++i) {
+            generation* g = &gens[i];
+            while (g->scan < g->to_top) {
+                object* obj = (object *) (g->to + g->scan);
+                scan_object(obj);
+                g->scan += obj->clss->size;
+                grey = TRUE;
+            }
+        }
+
+        while (promoted_scan < promoted_count) {
+            scan_object(promoted[promoted_scan++]);
+            grey = TRUE;
+        }
+    }
+
+    promoted_count = 0;
+}
+
+void copying_init(generation* g) {
+    g->capacity = g->size / 2;
+    g->from = g->start;
+    g->to = g->start + g->capacity;
+}
+
+/**
+ * @brief 在复制收集器的代中顺序分配
+ *  1. 正在被复制时分配在to空间中，否则分配在from空间中
+ * 
+ * @param g
+ * @param size
+ * @return object*
+ */
+object* copying_alloc(generation* g, int size) {
+    int* top = g->collecting ? &g->to_top : &g->top;
+    void* space = g->collecting ? g->to : g->from;
+
+    if (*top + size > g->capacity) {
+        return NULL;
+    }
+
+    object* obj = (object *) (space + *top);
+    *top += size;
+
+    return obj;
+}
+
+int copying_used_bytes(generation* g) {
+    return g->top;
+}
+
+void mc_init(generation* g) {
+    g->capacity = g->size;
+    g->from = g->start;
+    g->to = NULL;
+}
+
+object* mc_alloc(generation* g, int size) {
+    if (g->top + size > g->capacity) {
+        return NULL;
+    }
+
+    object* obj = (object *) (g->from + g->top);
+    g->top += size;
+
+    return obj;
+}
+
+int mc_used_bytes(generation* g) {
+    return g->top;
+}
+
+/**
+ * @brief 标记-压缩
+ *  1. 从所有GC ROOTS出发标记所有代中的活动对象，年轻的代中的对象不回收，但是会被搜索
+ *  2. 和Lisp2算法一样分三步：设定forwarding指针、更新指针、移动对象
+ *  3. 移动之后，年轻的代的记录集中来自这一代的对象都失效了，重新记录
+ * 
+ * @param g
+ */
+void mc_collect(generation* g) {
+    int gen = g - gens;
+
+    mark_all();
+
+    // 设定forwarding指针
+    void* scan = g->from;
+    for (void* p = g->from; p < g->from + g->top; p += ((object *) p)->clss->size) {
+        object* obj = (object *) p;
+        if (obj->marked) {
+            obj->forwarding = scan;
+            scan += obj->clss->size;
+        }
+    }
+
+    // 更新指针
+    for (int i = 0; i < _rp; ++i) {
+        if (gc_generation_of(_roots[i]) == gen) {
+            _roots[i] = _roots[i]->forwarding;
+        }
+    }
+
+    for (int i = 0; i <= gen; ++i) {
+        for (void* p = gens[i].from; p < gens[i].from + gens[i].top; p += ((object *) p)->clss->size) {
+            object* obj = (object *) p;
+            if (!obj->marked) {
+                continue;
+            }
+
+            for (int j = 0; j < obj->clss->num_fields; ++j) {
+                object** field = (object **) ((void *) obj + obj->clss->field_offsets[j]);
+                if (gc_generation_of(*field) == gen) {
+                    *field = (*field)->forwarding;
+                }
+            }
+
+            // 年轻的代中的对象只需要清除标记
+            if (i < gen) {
+                obj->marked = FALSE;
+            }
+        }
+    }
+
+    for (int i = 0; i < gen; ++i) {
+        int n = 0;
+        for (int j = 0; j < gens[i].rsp; ++j) {
+            if (gc_generation_of(gens[i].rs[j]) != gen) {
+                gens[i].rs[n++] = gens[i].rs[j];
+            }
+        }
+        gens[i].rsp = n;
+    }
+
+    // 移动对象
+    void* p = g->from;
+    while (p < g->from + g->top) {
+        object* obj = (object *) p;
+        int size = obj->clss->size;
+
+        if (obj->marked) {
+            object* forwarding = obj->forwarding;
+            memmove(forwarding, obj, size);
+            forwarding->marked = FALSE;
+            forwarding->remembered = 0;
+            forwarding->forwarding = NULL;
+        }
+
+        p += size;
+    }
+
+    printf("[Gen %d]collection %d bytes\n", gen, (int) (g->from + g->top - scan));
+    g->top = scan - g->from;
+
+    for (p = g->from; p < g->from + g->top; p += ((object *) p)->clss->size) {
+        object* obj = (object *) p;
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            int ref_gen = gc_generation_of(*(object **) ((void *) obj + obj->clss->field_offsets[i]));
+            if (ref_gen >= 0 && ref_gen < gen) {
+                remember(obj, ref_gen);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 从所有GC ROOTS出发，标记所有代中的活动对象
+ *  1. 使用标记栈而不是递归，很长的链表也不会栈溢出
+ * 
+ */
+void mark_all() {
+    for (int i = 0; i < _rp; ++i) {
+        mark_push(_roots[i]);
+    }
+
+    while (mark_sp > 0) {
+        object* obj = mark_stack[--mark_sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            mark_push(*(object **) ((void *) obj + obj->clss->field_offsets[i]));
+        }
+    }
+}
+
+void mark_push(object* obj) {
+    if (!obj || obj->marked) {
+        return;
+    }
+
+    obj->marked = TRUE;
+    push_object(&mark_stack, &mark_sp, &mark_stack_capacity, obj);
+}
+
+/**
+ * @brief 获取GC状态
+ * 
+ * @return char*
+ */
+char* gc_get_state() {
+    printf("Heap Usage:\n");
+
+    for (int i = 0; i < num_generations; ++i) {
+        generation* g = &gens[i];
+        int used = g->collector->used_bytes(g);
+
+        printf("Generation %d (%s):\n", i, g->collector->name);
+        printf("   capacity    = %d\n", g->capacity);
+        printf("   used        = %d\n", used);
+        printf("   free        = %d\n", g->capacity - used);
+        printf("   %g%% used\n", (double) used / g->capacity * 100);
+        printf("   collections = %d\n", g->collections);
+        printf("   promoted    = %d\n", g->promoted_bytes);
+        printf("   remembered  = %d\n", g->rsp);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,202 @@
+#ifndef GC_IMPL_GC_H
+#define GC_IMPL_GC_H
+
+#endif
+
+// 1字节的byte类型，用来做标识位
+typedef unsigned char byte;
+
+// 类描述
+typedef struct class_descriptor {
+    char* name;         // 类名称
+    int size;           // 类大小，即对应sizeof(struct)
+    int num_fields;     // 属性数量
+    int* field_offsets; // 类中的属性偏移，即所有属性在struct中偏移量(字节)
+} class_descriptor;
+
+/**
+ * @brief 基本对象类型
+ *  1. 所有对象都继承于Object
+ *  2. C中没有继承的概念，不过可以通过定义相同属性来实现，所有“继承”Object的struct，都需要将class/marked属性定义在开头
+ * 
+ */
+typedef struct _object object;
+struct _object {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在哪些代的记录集中，第i位对应第i代
+    object* forwarding;     // 目标位置
+    int age;                // 对象在当前这一代中的年龄
+};
+
+#define MAX_ROOTS 100
+
+#define MAX_HEAP_SIZE 1024 * 1024 * 10 // 10MB
+
+#define MAX_GENERATIONS 8   // 最多的代数，remembered的每一位对应一代
+
+#define DEFAULT_GENERATIONS 3   // 默认的代数
+
+#define DEFAULT_TENURE_AGE 2    // 默认在一代中经历几次GC后晋升到下一代
+
+#define GEN_FULL_RATIO 75   // 一代的使用率(%)超过该值时，下次GC把它和比它年轻的代一起收集
+
+typedef struct _generation generation;
+
+/**
+ * @brief 每一代的收集器
+ *  1. 复制收集器的代在收集时把活动对象复制到to空间或者晋升到下一代，由收集youngest k的过程统一完成
+ *  2. 不复制的收集器(collect不为NULL)在原地回收，只能用于最老的一代
+ * 
+ */
+typedef struct gen_collector {
+    char* name;
+    void (*init)(generation* g);                // 划分这一代的空间
+    object* (*alloc)(generation* g, int size);  // 在这一代中分配，放不下时返回NULL
+    int (*used_bytes)(generation* g);           // 这一代已经使用的大小
+    void (*collect)(generation* g);             // 原地回收这一代，复制收集器为NULL
+} gen_collector;
+
+// 复制收集器，空间分成from/to两半
+extern gen_collector copying_collector;
+
+// 标记-压缩收集器，顺序分配，只能用于最老的一代
+extern gen_collector mark_compact_collector;
+
+/**
+ * @brief 代
+ *  1. 第0代最年轻，新对象都分配在第0代中
+ *  2. 对象在一代中经历tenure_age次GC后晋升到下一代，最老的一代不再晋升
+ *  3. 除了最老的一代，每代都有一个记录集，只记录比它老的代中引用了这一代对象的对象
+ * 
+ */
+struct _generation {
+    gen_collector* collector;   // 这一代使用的收集器
+    int weight;                 // 这一代在堆中所占的比重
+    int tenure_age;             // 晋升年龄
+    void* start;                // 这一代的开头
+    int size;                   // 这一代的大小
+    void* from;                 // 分配使用的空间，标记-压缩时就是整个代
+    void* to;                   // 复制的目标空间，标记-压缩时不使用
+    int capacity;               // from空间的大小
+    int top;                    // from空间中下一个空闲位置（相对位置）
+    int to_top;                 // 收集时to空间中下一个空闲位置
+    int scan;                   // 收集时to空间中下一个要搜索的位置
+    byte collecting;            // 是否正在被复制
+    int promote_room;           // 正在被复制时，to空间中留给晋升对象的大小，其余留给from空间中的幸存对象
+    object** rs;                // 记录集
+    int rsp;
+    int rs_capacity;
+    int collections;            // 被收集的次数
+    int promoted_bytes;         // 晋升到这一代的对象总大小
+};
+
+const static byte TRUE = 1;
+const static byte FALSE = 0;
+
+/**
+ * @brief GC ROOTS
+ * 
+ */
+extern object* _roots[MAX_ROOTS];
+
+// GC ROOT 的当前下标，即记录到了第几个元素
+extern int _rp;
+
+// 堆总大小
+extern int heap_size;
+
+// 代数
+extern int num_generations;
+
+// 所有的代，下标越大越老
+extern generation gens[MAX_GENERATIONS];
+
+/**
+ * @brief 设置代数，每代恢复默认配置，需要在gc_init之前调用
+ *  1. 默认第i代的比重为2^i，晋升年龄为DEFAULT_TENURE_AGE
+ *  2. 默认最老的一代使用标记-压缩收集器，其他代使用复制收集器
+ * 
+ * @param n 代数，2到MAX_GENERATIONS
+ */
+extern void gc_set_generations(int n);
+
+/**
+ * @brief 设置一代的配置，需要在gc_set_generations之后、gc_init之前调用
+ * 
+ * @param gen 第几代
+ * @param weight 在堆中所占的比重
+ * @param tenure_age 晋升年龄
+ * @param collector 收集器，不复制的收集器只能用于最老的一代
+ */
+extern void gc_set_generation(int gen, int weight, int tenure_age, gen_collector* collector);
+
+/**
+ * @brief 初始化GC
+ * 
+ * @param size
+ */
+extern void gc_init(int size);
+
+/**
+ * @brief 执行GC，收集所有的代
+ * 
+ */
+extern void gc();
+
+/**
+ * @brief 收集最年轻的k代
+ *  1. 比k代老的代中引用了这些代对象的对象，通过记录集找到，当作根
+ * 
+ * @param k
+ */
+extern void gc_collect(int k);
+
+/**
+ * @brief GC结束，彻底清理堆
+ * 
+ */
+extern void gc_done();
+
+/**
+ * @brief 在GC堆上分配指定类型的内存
+ *  1. 在第0代中顺序分配，放不下时收集最年轻的几代
+ * 
+ * @param clss 需要分配的类型
+ * @return object* 分配的对象指针
+ */
+extern object* gc_alloc(class_descriptor* clss);
+
+/**
+ * @brief 修改引用
+ * 
+ * @param obj 原对象
+ * @param field_ref 原对象的属性指针
+ * @param new_obj 新对象指针
+ */
+void gc_update_ptr(object* obj, object** field_ref, object* new_obj);
+
+/**
+ * @brief 对象位于第几代
+ * 
+ * @param obj
+ * @return int 不在堆中时返回-1
+ */
+extern int gc_generation_of(object* obj);
+
+/**
+ * @brief DUMP GC状态
+ * 
+ * @return char*
+ */
+extern char* gc_get_state();
+
+// 暂存GC ROOTS下标
+#define gc_save_rp int __rp = _rp;
+
+// 将对象添加到GC ROOTS
+#define gc_add_root(p) _roots[_rp++] = (object *)(p);
+
+// 恢复GC ROOTS下标
+#define gc_restore_roots _rp = __rp;
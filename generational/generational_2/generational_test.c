@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "generational.h"
+
+typedef struct emp {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在哪些代的记录集中
+    object* forwarding;     // 目标位置
+    int age;                // 对象年龄
+    int id;
+    struct emp* next;
+} emp;
+
+class_descriptor emp_object_class = {
+    "emp_object",
+    sizeof(struct emp),
+    1,
+    (int[]) {
+        offsetof(struct emp, next)
+    }
+};
+
+typedef struct link {
+    class_descriptor* clss; // 对象对应的类型
+    byte forwarded;         // 已拷贝标识
+    byte marked;            // reachable标识
+    byte remembered;        // 已经记录在哪些代的记录集中
+    object* forwarding;     // 目标位置
+    int age;                // 对象年龄
+    int id;
+    struct link* next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
+// 检查链表的内容
+void check_links(link* head, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (!head || head->id != i) {
+            printf("link list corrupted!\n");
+            abort();
+        }
+        head = head->next;
+    }
+}
+
+// 分配垃圾对象，触发第0代的GC
+void make_garbage(int count) {
+    for (int i = 0; i < count; ++i) {
+        emp* temp_emp = (emp *) gc_alloc(&emp_object_class);
+    }
+}
+
+// 创建一个id从0开始的链表，创建过程中链表头暂存在GC ROOTS中
+link* make_links(int count) {
+    gc_save_rp;
+    gc_add_root(NULL);
+
+    for (int i = count - 1; i >= 0; --i) {
+        link* l = (link *) gc_alloc(&link_object_class);
+        l->id = i;
+        l->next = (link *) _roots[__rp];
+        _roots[__rp] = (object *) l;
+    }
+
+    link* head = (link *) _roots[__rp];
+    gc_restore_roots;
+
+    return head;
+}
+
+// 测试对象一代一代地晋升
+void test_promotion(){
+    printf("test_promotion\n");
+    gc_set_generations(4);
+    gc_init(100000);
+
+    gc_add_root(make_links(20));
+    if (gc_generation_of(_roots[0]) != 0) {
+        printf("new object is not in generation 0!\n");
+        abort();
+    }
+
+    // 只收集第0代时，第0代中的对象晋升到第1代后就留在那里
+    make_garbage(1000);
+    check_links((link *) _roots[0], 20);
+    if (gc_generation_of(_roots[0]) != 1) {
+        printf("object is not promoted to generation 1!\n");
+        abort();
+    }
+
+    // 收集最年轻的3代，每一代经历DEFAULT_TENURE_AGE次GC后晋升到下一代
+    for (int i = 0; i < 2 * DEFAULT_TENURE_AGE; ++i) {
+        gc_collect(3);
+        check_links((link *) _roots[0], 20);
+
+        int expected = 1 + (i + 1) / DEFAULT_TENURE_AGE;
+        if (gc_generation_of(_roots[0]) != expected) {
+            printf("object is in generation %d, expected %d!\n", gc_generation_of(_roots[0]), expected);
+            abort();
+        }
+    }
+
+    gc();
+    check_links((link *) _roots[0], 20);
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试记录集：老的代引用年轻的代的对象时，只收集年轻的代也不能回收它
+void test_remembered_set(){
+    printf("test_remembered_set\n");
+    gc_set_generations(3);
+    gc_init(100000);
+
+    // 链表晋升到最老的一代
+    gc_add_root(make_links(10));
+    for (int i = 0; i < 2 * DEFAULT_TENURE_AGE; ++i) {
+        gc_collect(2);
+    }
+    if (gc_generation_of(_roots[0]) != 2) {
+        printf("object is not promoted to the oldest generation!\n");
+        abort();
+    }
+
+    // 在最老的一代的链表末尾接上新对象，只有最老的一代引用它们
+    link* l = make_links(20);
+    for (link* p = l; p; p = p->next) {
+        p->id += 10;
+    }
+
+    link* tail = (link *) _roots[0];
+    while (tail->next) {
+        tail = tail->next;
+    }
+    gc_update_ptr((object *) tail, (object **) &tail->next, (object *) l);
+
+    // 新对象经过第1代晋升到第2代，中间只收集年轻的代，以及一次全部收集
+    for (int i = 0; i < 30; ++i) {
+        make_garbage(100);
+        check_links((link *) _roots[0], 30);
+        if (i % 5 == 4) {
+            gc_collect(2);
+            check_links((link *) _roots[0], 30);
+        }
+        if (i == 10) {
+            gc();
+            check_links((link *) _roots[0], 30);
+        }
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 中等寿命的对象：在几次第0代的GC之后死去
+int medium_lifetime_workload(int generations) {
+    gc_set_generations(generations);
+    if (generations > 2) {
+        gc_set_generation(1, 2, 8, &copying_collector);
+    }
+    gc_init(100000);
+
+    for (int i = 0; i < 8; ++i) {
+        gc_add_root(NULL);
+    }
+
+    // 每一轮替换一个槽中的链表，链表活8轮
+    for (int r = 0; r < 200; ++r) {
+        _roots[r % 8] = (object *) make_links(10);
+        make_garbage(50);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        check_links((link *) _roots[i], 10);
+    }
+
+    gc_get_state();
+
+    int promoted = gens[generations - 1].promoted_bytes;
+    gc_done();
+
+    return promoted;
+}
+
+// 测试多代：中等寿命的对象在中间代中死去，不再涌入最老的一代
+void test_intermediate_lifetime(){
+    printf("test_intermediate_lifetime\n");
+
+    int two = medium_lifetime_workload(2);
+    int three = medium_lifetime_workload(3);
+
+    printf("promoted to the oldest generation: 2 generations = %d, 3 generations = %d\n", two, three);
+    if (three * 4 > two) {
+        printf("intermediate generation does not filter medium-lived objects!\n");
+        abort();
+    }
+}
+
+// 测试中间代快满时一起收集：年轻的代晋升到它的to空间中，它自己的幸存对象也要放得下
+void test_full_middle_generation(){
+    printf("test_full_middle_generation\n");
+    gc_set_generations(3);
+    gc_init(100000);
+
+    // 95个链表都活着，每个节点之后跟着一个垃圾对象，只通过gc_alloc触发GC
+    for (int r = 0; r < 95; ++r) {
+        gc_add_root(NULL);
+        for (int i = 4; i >= 0; --i) {
+            link* l = (link *) gc_alloc(&link_object_class);
+            l->id = i;
+            l->next = (link *) _roots[r];
+            _roots[r] = (object *) l;
+            make_garbage(1);
+        }
+    }
+
+    for (int r = 0; r < 95; ++r) {
+        check_links((link *) _roots[r], 5);
+    }
+    if (gens[1].collections == 0) {
+        printf("middle generation is never collected!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+int main(int argc, char* argv[]) {
+
+    test_promotion();
+    test_remembered_set();
+    test_intermediate_lifetime();
+    test_full_middle_generation();
+
+    return 0;
+}
@@ -0,0 +1,455 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "immix.h"
+
+object* _roots[MAX_ROOTS];
+int _rp;
+
+void* heap_start;
+int heap_size;
+int num_lines;
+int num_blocks;
+byte* line_marks;
+
+int* block_live;        // 上一次GC时每个块中标记的线数
+byte* block_flags;      // 块的用途
+
+#define BLOCK_RESERVED 1    // 保留给疏散的空闲块
+#define BLOCK_OVERFLOW 2    // 溢出分配正在使用的块
+#define BLOCK_EVACUATE 4    // 这次GC要疏散的块
+
+void* cursor;           // 当前空洞中下一个空闲位置
+void* limit;            // 当前空洞的结尾
+int next_line;          // 下一次从这条线开始找空洞
+
+void* overflow_cursor;  // 溢出分配的块中下一个空闲位置
+void* overflow_limit;
+
+void* evac_cursor;      // 疏散时保留的块中下一个空闲位置
+void* evac_limit;
+int evac_block;         // 下一次从这个块开始找保留的块
+
+object** stack;         // 标记对象用的栈
+int sp;
+int stack_capacity;
+
+byte mark_epoch;        // 每次GC在1和2之间切换，新对象是0
+
+int collections;        // GC次数
+int evacuated_blocks;   // 疏散的块数
+int copied_bytes;       // 复制的对象总大小
+
+/**
+ * @brief 对象大小，按8字节对齐
+ *
+ * @param clss
+ * @return int
+ */
+int object_size(class_descriptor* clss);
+
+/**
+ * @brief 从next_line开始找能放下size的空洞
+ *  1. 空洞是同一个块中连续的没有标记的线
+ *  2. 跳过保留给疏散的块和溢出分配使用的块
+ *
+ * @param size
+ * @return byte 找不到时返回FALSE
+ */
+byte find_hole(int size);
+
+/**
+ * @brief 在空洞中顺序分配
+ *
+ * @param size
+ * @return void* 找不到空洞时返回NULL
+ */
+void* bump(int size);
+
+/**
+ * @brief 溢出分配
+ *  1. 在顺序分配还没有到达的空闲块中分配中等对象
+ *
+ * @param size
+ * @return void* 找不到空闲块时返回NULL
+ */
+void* overflow_bump(int size);
+
+/**
+ * @brief 在保留的块中分配疏散的对象
+ *
+ * @param size
+ * @return void* 保留的块用完时返回NULL
+ */
+void* evac_bump(int size);
+
+/**
+ * @brief 选出疏散的候选块
+ *  1. 活动线越少的块越先被选中，选中的块的活动线总数不超过保留的块的线数
+ *
+ */
+void select_evacuation();
+
+/**
+ * @brief 标记属性引用的对象
+ *  1. 第一次标记时，疏散的块中的对象被复制到保留的块中，属性改为指向新的位置
+ *  2. 标记对象占用的所有线
+ *
+ * @param field_ref
+ * @param movable GC ROOTS直接引用的对象不能移动
+ */
+void trace_field(object** field_ref, byte movable);
+
+/**
+ * @brief 把一个保留的块交给顺序分配
+ *  1. 保留的块在堆的末尾，顺序分配已经跳过了它们，直接作为下一个空洞
+ *
+ * @return byte 没有保留的块时返回FALSE
+ */
+byte release_headroom();
+
+/**
+ * @brief 根据线的标识统计每个块，重新保留空闲块，重置分配器
+ *
+ */
+void reset_allocator();
+
+int object_size(class_descriptor* clss) {
+    return (clss->size + 7) / 8 * 8;
+}
+
+byte find_hole(int size) {
+    while (next_line < num_lines) {
+        int b = next_line / LINES_PER_BLOCK;
+        if (block_flags[b] & (BLOCK_RESERVED | BLOCK_OVERFLOW)) {
+            next_line = (b + 1) * LINES_PER_BLOCK;
+            continue;
+        }
+        if (line_marks[next_line]) {
+            next_line++;
+            continue;
+        }
+
+        // 空洞不跨越块
+        int start = next_line;
+        int block_end = (b + 1) * LINES_PER_BLOCK;
+        while (next_line < block_end && !line_marks[next_line]) {
+            next_line++;
+        }
+
+        if ((next_line - start) * LINE_SIZE >= size) {
+            cursor = heap_start + start * LINE_SIZE;
+            limit = heap_start + next_line * LINE_SIZE;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void* bump(int size) {
+    if (!cursor || cursor + size > limit) {
+        if (!find_hole(size)) {
+            return NULL;
+        }
+    }
+
+    void* p = cursor;
+    cursor += size;
+    return p;
+}
+
+void* overflow_bump(int size) {
+    if (!overflow_cursor || overflow_cursor + size > overflow_limit) {
+        // 顺序分配已经进入的块不能使用
+        int b = (next_line + LINES_PER_BLOCK - 1) / LINES_PER_BLOCK;
+        while (b < num_blocks && (block_live[b] > 0 || block_flags[b])) {
+            b++;
+        }
+        if (b == num_blocks) {
+            return NULL;
+        }
+
+        block_flags[b] |= BLOCK_OVERFLOW;
+        overflow_cursor = heap_start + b * BLOCK_SIZE;
+        overflow_limit = overflow_cursor + BLOCK_SIZE;
+    }
+
+    void* p = overflow_cursor;
+    overflow_cursor += size;
+    return p;
+}
+
+void* evac_bump(int size) {
+    if (!evac_cursor || evac_cursor + size > evac_limit) {
+        while (evac_block < num_blocks && !(block_flags[evac_block] & BLOCK_RESERVED)) {
+            evac_block++;
+        }
+        if (evac_block == num_blocks) {
+            return NULL;
+        }
+
+        evac_cursor = heap_start + evac_block * BLOCK_SIZE;
+        evac_limit = evac_cursor + BLOCK_SIZE;
+        evac_block++;
+    }
+
+    void* p = evac_cursor;
+    evac_cursor += size;
+    return p;
+}
+
+byte release_headroom() {
+    for (int b = 0; b < num_blocks; ++b) {
+        if (block_flags[b] & BLOCK_RESERVED) {
+            block_flags[b] &= ~BLOCK_RESERVED;
+            cursor = heap_start + b * BLOCK_SIZE;
+            limit = cursor + BLOCK_SIZE;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void push(object* obj) {
+    if (sp == stack_capacity) {
+        stack_capacity = stack_capacity ? stack_capacity * 2 : 256;
+        stack = (object **) realloc(stack, stack_capacity * sizeof(object *));
+    }
+    stack[sp++] = obj;
+}
+
+void select_evacuation() {
+    int budget = 0;
+    for (int b = 0; b < num_blocks; ++b) {
+        budget += block_flags[b] & BLOCK_RESERVED ? LINES_PER_BLOCK : 0;
+    }
+
+    for (int live = 1; live * 100 <= LINES_PER_BLOCK * DEFRAG_THRESHOLD; ++live) {
+        for (int b = 0; b < num_blocks; ++b) {
+            if (block_live[b] == live && live <= budget) {
+                block_flags[b] |= BLOCK_EVACUATE;
+                budget -= live;
+                evacuated_blocks++;
+            }
+        }
+    }
+}
+
+void trace_field(object** field_ref, byte movable) {
+    object* obj = *field_ref;
+    if (!obj) {
+        return;
+    }
+
+    if (obj->marked == FORWARDED) {
+        *field_ref = (object *) obj->clss;
+        return;
+    }
+
+    if (obj->marked == mark_epoch) {
+        return;
+    }
+
+    int size = object_size(obj->clss);
+    if (movable && block_flags[gc_line_of(obj) / LINES_PER_BLOCK] & BLOCK_EVACUATE) {
+        object* copy = (object *) evac_bump(size);
+        if (copy) {
+            memcpy(copy, obj, size);
+            obj->marked = FORWARDED;
+            obj->clss = (class_descriptor *) copy;
+            copied_bytes += size;
+            obj = copy;
+            *field_ref = copy;
+        }
+    }
+
+    obj->marked = mark_epoch;
+    int last = gc_line_of((void *) obj + size - 1);
+    for (int i = gc_line_of(obj); i <= last; ++i) {
+        line_marks[i] = TRUE;
+    }
+    push(obj);
+}
+
+void reset_allocator() {
+    int free_blocks = 0;
+    for (int b = 0; b < num_blocks; ++b) {
+        block_live[b] = 0;
+        for (int i = b * LINES_PER_BLOCK; i < (b + 1) * LINES_PER_BLOCK; ++i) {
+            block_live[b] += line_marks[i];
+        }
+        block_flags[b] = 0;
+        free_blocks += block_live[b] == 0;
+    }
+
+    // 最后几个空闲块保留给下一次GC疏散，只剩下它们时不保留
+    int reserve = free_blocks > EVAC_HEADROOM ? EVAC_HEADROOM : 0;
+    for (int b = num_blocks - 1; b >= 0 && reserve > 0; --b) {
+        if (block_live[b] == 0) {
+            block_flags[b] = BLOCK_RESERVED;
+            reserve--;
+        }
+    }
+
+    cursor = NULL;
+    limit = NULL;
+    next_line = 0;
+    overflow_cursor = NULL;
+    overflow_limit = NULL;
+    evac_cursor = NULL;
+    evac_limit = NULL;
+    evac_block = 0;
+}
+
+void gc_init(int size) {
+    if (size > MAX_HEAP_SIZE) {
+        size = MAX_HEAP_SIZE;
+    }
+    heap_size = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    if (heap_size == 0) {
+        heap_size = BLOCK_SIZE;
+    }
+
+    heap_start = malloc(heap_size);
+    num_lines = heap_size / LINE_SIZE;
+    num_blocks = heap_size / BLOCK_SIZE;
+    line_marks = (byte *) calloc(num_lines, 1);
+    block_live = (int *) calloc(num_blocks, sizeof(int));
+    block_flags = (byte *) calloc(num_blocks, 1);
+    reset_allocator();
+
+    _rp = 0;
+    sp = 0;
+    mark_epoch = 1;
+
+    collections = 0;
+    evacuated_blocks = 0;
+    copied_bytes = 0;
+}
+
+void gc() {
+    printf("collection ...\n");
+    collections++;
+
+    select_evacuation();
+
+    mark_epoch = mark_epoch == 1 ? 2 : 1;
+    memset(line_marks, 0, num_lines);
+
+    // GC ROOTS直接引用的对象先标记，之后通过其他对象找到它们时也不会移动
+    for (int i = 0; i < _rp; ++i) {
+        trace_field(&_roots[i], FALSE);
+    }
+
+    while (sp > 0) {
+        object* obj = stack[--sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            trace_field((object **) ((void *) obj + obj->clss->field_offsets[i]), TRUE);
+        }
+    }
+
+    reset_allocator();
+}
+
+void gc_done() {
+    free(heap_start);
+    free(line_marks);
+    free(block_live);
+    free(block_flags);
+    free(stack);
+    heap_start = NULL;
+    line_marks = NULL;
+    block_live = NULL;
+    block_flags = NULL;
+    stack = NULL;
+    stack_capacity = 0;
+}
+
+/**
+ * @brief 中等对象放不进当前空洞时先溢出分配
+ *
+ * @param size
+ * @return void*
+ */
+void* allocate(int size) {
+    if (size > LINE_SIZE && (!cursor || cursor + size > limit)) {
+        void* p = overflow_bump(size);
+        if (p) {
+            return p;
+        }
+    }
+
+    return bump(size);
+}
+
+object* gc_alloc(class_descriptor* clss) {
+    int size = object_size(clss);
+    if (size > BLOCK_SIZE) {
+        printf("Object is too large!\n");
+        abort();
+    }
+
+    object* new_obj = (object *) allocate(size);
+
+    // 找不到空洞就执行GC，还不够就使用保留的块
+    if (!new_obj) {
+        gc();
+        new_obj = (object *) allocate(size);
+    }
+
+    while (!new_obj && release_headroom()) {
+        new_obj = (object *) allocate(size);
+    }
+
+    //再找不到真的没了……
+    if (!new_obj) {
+        printf("Allocation Failed!OutOfMemory...\n");
+        abort();
+    }
+
+    new_obj->clss = clss;
+    new_obj->marked = FALSE;
+
+    for (int i = 0; i < clss->num_fields; ++i) {
+        *(object **) ((void *) new_obj + clss->field_offsets[i]) = NULL;
+    }
+
+    return new_obj;
+}
+
+int gc_line_of(void* obj) {
+    return (obj - heap_start) / LINE_SIZE;
+}
+
+int gc_free_lines() {
+    int free_lines = 0;
+    for (int i = 0; i < num_lines; ++i) {
+        free_lines += !line_marks[i];
+    }
+
+    return free_lines;
+}
+
+char *gc_get_state() {
+    int free_blocks = 0;
+    int recyclable_blocks = 0;
+    for (int b = 0; b < num_blocks; ++b) {
+        free_blocks += block_live[b] == 0;
+        recyclable_blocks += block_live[b] > 0 && block_live[b] < LINES_PER_BLOCK;
+    }
+
+    printf("Heap Usage:\n");
+    printf("   blocks      = %d (%d free, %d recyclable)\n", num_blocks, free_blocks, recyclable_blocks);
+    printf("   lines       = %d (%d free)\n", num_lines, gc_free_lines());
+    printf("   collections = %d\n", collections);
+    printf("   evacuated   = %d blocks\n", evacuated_blocks);
+    printf("   copied      = %d\n", copied_bytes);
+
+    return NULL;
+}
+
+int gc_num_roots() {
+    return _rp;
+}
@@ -0,0 +1,152 @@
+#ifndef GC_IMPL_IMMIX_GC_H
+#define GC_IMPL_IMMIX_GC_H
+
+#endif
+
+/**
+ * @brief 1字节的byte类型，用来做标识位
+ *
+ */
+typedef unsigned char byte;
+
+/**
+ * @brief 类描述
+ *
+ */
+typedef struct class_descriptor {
+    char *name;         // 类名称
+    int size;           // 类大小，即对应sizeof(struct)
+    int num_fields;     // 属性数量
+    int *field_offsets; // 类中的属性偏移，即所有属性在struct中的偏移量(字节)
+} class_descriptor;
+
+/**
+ * @brief 基本对象类型
+ *  1. 所有对象都继承于Object
+ *  2. C中没有继承的概念，不过可以通过定义相同属性来实现，所有“继承”Object的struct，都需要将class/marked属性定义在开头
+ *  3. 和mark_sweep_3的对象头相同，已拷贝的对象不需要额外的forwarding属性，目标位置记录在clss中
+ *
+ */
+typedef struct _object object;
+struct _object {
+    class_descriptor *clss;    // 对象对应的类型，已拷贝时是目标位置
+    byte marked;                // 和mark_epoch相同表示已标记，FORWARDED表示已拷贝
+};
+
+#define FORWARDED 3     // 已拷贝的对象的marked
+
+#define MAX_ROOTS 100
+
+#define BLOCK_SIZE (32 * 1024)  // 块大小(B)
+
+#define LINE_SIZE 256           // 线大小(B)，大于它的对象是中等对象
+
+#define LINES_PER_BLOCK (BLOCK_SIZE / LINE_SIZE)
+
+#define MAX_HEAP_SIZE 1024 * 1024 * 64 // 64MB
+
+#define DEFRAG_THRESHOLD 25     // 活动线的比例(%)不超过该值的块是疏散的候选
+
+#define EVAC_HEADROOM 1         // 保留给疏散的空闲块数
+
+const static byte TRUE = 1;
+const static byte FALSE = 0;
+
+/**
+ * @brief GC ROOTS
+ *  1. GC ROOTS直接引用的对象不会被疏散，局部变量中的指针在GC之后仍然有效
+ *  2. 只通过其他对象引用的对象可能被疏散，GC之后要从GC ROOTS重新读取
+ *
+ */
+extern object* _roots[MAX_ROOTS];
+
+// GC ROOT 的当前下标，即记录到了第几个元素
+extern int _rp;
+
+// 堆的起始地址
+extern void* heap_start;
+
+// 堆总大小，BLOCK_SIZE的整数倍
+extern int heap_size;
+
+// 线的总数
+extern int num_lines;
+
+/**
+ * @brief 线的标识
+ *  1. 上一次GC时有活动对象的线，跨越多条线的对象标记它占用的所有线
+ *  2. 没有标记的线在GC之后可以重新分配
+ *
+ */
+extern byte* line_marks;
+
+/**
+ * @brief 初始化GC
+ *
+ * @param size 堆大小，向上取整为BLOCK_SIZE的整数倍
+ */
+extern void gc_init(int size);
+
+/**
+ * @brief 执行GC
+ *  1. 根据上一次GC时每个块的活动线数，选出疏散的候选块，疏散的对象总大小不超过保留的空闲块
+ *  2. 从GC ROOTS开始标记对象和它占用的线，候选块中的对象被复制到保留的空闲块中，空间不够时留在原处
+ *  3. 不需要清除阶段，没有标记的线就是空闲的
+ *
+ */
+extern void gc();
+
+/**
+ * @brief GC结束，彻底清理堆
+ *
+ */
+extern void gc_done();
+
+/**
+ * @brief 在GC堆上分配指定类型的内存
+ *  1. 在没有标记的线组成的空洞中顺序分配，空洞不够大时找下一个空洞
+ *  2. 中等对象放不进当前空洞时，在空闲块中溢出分配，不跳过当前空洞
+ *  3. 找不到空洞时执行GC，还不够就使用保留给疏散的空闲块
+ *
+ * @param clss 需要分配的类型
+ * @return object* 分配的对象指针
+ */
+extern object* gc_alloc(class_descriptor* clss);
+
+/**
+ * @brief 对象所在的线
+ *
+ * @param obj
+ * @return int
+ */
+extern int gc_line_of(void* obj);
+
+/**
+ * @brief 没有标记的线数
+ *
+ * @return int
+ */
+extern int gc_free_lines();
+
+/**
+ * @brief DUMP GC状态
+ *
+ * @return char*
+ */
+extern char *gc_get_state();
+
+/**
+ * @brief 获取GC ROOTS数量
+ *
+ * @return int ROOTS数量
+ */
+extern int gc_num_roots();
+
+// 暂存GC ROOTS下标
+#define gc_save_rp int __rp = _rp;
+
+// 将对象添加到GC ROOTS
+#define gc_add_root(p) _roots[_rp++] = (object *)(p);
+
+// 恢复GC ROOTS下标
+#define gc_restore_roots _rp = __rp;
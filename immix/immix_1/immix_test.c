@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "immix.h"
+
+typedef struct emp {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+    int id;
+    struct dept *dept;
+} emp;
+
+typedef struct dept {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+    int id;
+} dept;
+
+class_descriptor emp_object_class = {
+    "emp_object",
+    sizeof(struct emp),
+    1,
+    (int[]) {
+        offsetof(struct emp, dept)
+    }
+};
+
+class_descriptor dept_object_class = {
+    "dept_object",
+    sizeof(struct dept),
+    0,
+    NULL
+};
+
+typedef struct link {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+    int id;
+    struct link *next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
+// 大于一条线的中等对象
+typedef struct buffer {
+    class_descriptor *clss;    // 对象对应的类型
+    byte marked;                // 标记对象是否可达（reachable）
+    char data[1000];
+} buffer;
+
+class_descriptor buffer_object_class = {
+    "buffer_object",
+    sizeof(struct buffer),
+    0,
+    NULL
+};
+
+// 有标记的线的块数
+int used_blocks() {
+    int used = 0;
+    for (int b = 0; b < num_lines / LINES_PER_BLOCK; ++b) {
+        for (int i = b * LINES_PER_BLOCK; i < (b + 1) * LINES_PER_BLOCK; ++i) {
+            if (line_marks[i]) {
+                used++;
+                break;
+            }
+        }
+    }
+
+    return used;
+}
+
+// 在GC ROOTS的第slot个位置上创建一个id从0开始的链表，每个对象之后跟着garbage个垃圾
+void make_list(int slot, int count, int garbage) {
+    _roots[slot] = NULL;
+    for (int i = count - 1; i >= 0; --i) {
+        link* l = (link *) gc_alloc(&link_object_class);
+        l->id = i;
+        l->next = (link *) _roots[slot];
+        _roots[slot] = (object *) l;
+
+        for (int j = 0; j < garbage; ++j) {
+            gc_alloc(&link_object_class);
+        }
+    }
+}
+
+// 检查链表的内容，id依次增加step
+void check_list(link* l, int count, int step) {
+    for (int i = 0; i < count; ++i, l = l->next) {
+        if (!l || l->id != i * step) {
+            printf("link list corrupted!\n");
+            abort();
+        }
+    }
+    if (l) {
+        printf("link list is too long!\n");
+        abort();
+    }
+}
+
+// 和mark_sweep_3相同的测试，GC ROOTS引用的对象不会移动
+void test_mark_sweep_compatible() {
+    printf("test_mark_sweep_compatible\n");
+    gc_init(BLOCK_SIZE * 2);
+
+    for (int i = 0; i < 3000; ++i) {
+        gc_save_rp;
+
+        emp *_emp1 = (emp *) gc_alloc(&emp_object_class);
+        gc_add_root(_emp1);
+
+        dept *_dept1 = (dept *) gc_alloc(&dept_object_class);
+        _emp1->dept = _dept1;
+        _dept1->id = i;
+
+        emp *_emp2 = (emp *) gc_alloc(&emp_object_class);
+        dept *_dept2 = (dept *) gc_alloc(&dept_object_class);
+        _emp2->dept = _dept2;
+
+        if (_emp1->dept->id != i) {
+            printf("object is corrupted!\n");
+            abort();
+        }
+
+        gc_restore_roots;
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试线的回收：GC之后在活动对象之间的空洞中分配
+void test_line_reuse() {
+    printf("test_line_reuse\n");
+    gc_init(BLOCK_SIZE * 4);
+    gc_add_root(NULL);
+
+    // 每条线中有一个活动对象，之后跟着一整条线的垃圾
+    make_list(0, 20, 2 * LINE_SIZE / sizeof(link));
+    gc();
+    check_list((link *) _roots[0], 20, 1);
+
+    int free_lines = gc_free_lines();
+    if (free_lines == num_lines || free_lines < num_lines - 40) {
+        printf("%d lines are free!\n", free_lines);
+        abort();
+    }
+
+    // 新对象分配在第一个块的空洞中
+    link* l = (link *) gc_alloc(&link_object_class);
+    if (line_marks[gc_line_of(l)] || gc_line_of(l) >= LINES_PER_BLOCK) {
+        printf("new object is not allocated in a hole!\n");
+        abort();
+    }
+    check_list((link *) _roots[0], 20, 1);
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试溢出分配：中等对象放不进当前空洞时不跳过它
+void test_overflow_allocation() {
+    printf("test_overflow_allocation\n");
+    gc_init(BLOCK_SIZE * 4);
+    gc_add_root(NULL);
+
+    // 活动对象的间隔比一条线稍大，第一个块的开头有一些只有一条线的空洞
+    make_list(0, 60, LINE_SIZE / sizeof(link) + 1);
+    gc();
+
+    link* small1 = (link *) gc_alloc(&link_object_class);
+    buffer* medium = (buffer *) gc_alloc(&buffer_object_class);
+    link* small2 = (link *) gc_alloc(&link_object_class);
+
+    if (gc_line_of(medium) / LINES_PER_BLOCK == gc_line_of(small1) / LINES_PER_BLOCK) {
+        printf("medium object is not overflow allocated!\n");
+        abort();
+    }
+    if ((void *) small2 != (void *) small1 + sizeof(link)) {
+        printf("hole is skipped by medium object!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试疏散：稀疏的块中的对象被复制到保留的块中
+void test_evacuation() {
+    printf("test_evacuation\n");
+    gc_init(BLOCK_SIZE * 8);
+    gc_add_root(NULL);
+
+    make_list(0, 3000, 0);
+    gc();
+
+    // 每100个对象留下一个，所有的块都很稀疏
+    for (link* l = (link *) _roots[0]; l; l = l->next) {
+        link* next = l;
+        for (int i = 0; i < 100 && next; ++i) {
+            next = next->next;
+        }
+        l->next = next;
+    }
+    gc();
+    check_list((link *) _roots[0], 30, 100);
+
+    // 疏散的候选块根据上一次GC的结果选出
+    link* head = (link *) _roots[0];
+    link* second = head->next;
+    int before = used_blocks();
+    gc();
+    check_list((link *) _roots[0], 30, 100);
+
+    if ((link *) _roots[0] != head) {
+        printf("object referenced by roots is moved!\n");
+        abort();
+    }
+    if (head->next == second) {
+        printf("object is not evacuated!\n");
+        abort();
+    }
+    if (used_blocks() >= before) {
+        printf("sparse blocks are not evacuated: %d -> %d\n", before, used_blocks());
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+int main(int argc, char* argv[]) {
+
+    test_mark_sweep_compatible();
+    test_line_reuse();
+    test_overflow_allocation();
+    test_evacuation();
+
+    return 0;
+}
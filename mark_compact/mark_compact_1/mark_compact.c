@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
 #include "mark_compact.h"
 
 object* _roots[MAX_ROOTS];
@@ -11,9 +15,33 @@ object* _roots[MAX_ROOTS];  // GC ROOTS
 int next_free_offset;       // 下一个空闲内存地址（相对位置）
 int heap_size;              // 堆容量
 
+#ifdef COMPACT_NO_FORWARDING
+compact_mode gc_compact_mode = COMPACT_TABLE;  // 压缩算法
+#else
+compact_mode gc_compact_mode = COMPACT_LISP2;  // 压缩算法
+#endif
+int cell_size = 0;                              // 统一的单元大小，0表示按对象实际大小分配
+byte gc_verbose = TRUE;                         // 是否打印GC过程日志
+double gc_compact_time = 0;                     // 累计的压缩阶段耗时(ms)
+
 // 计算并更新forwarding pointer
 void set_forwarding();
 
+// 根据区域的活动比例计算密集前缀
+int dense_prefix();
+
+// 本次GC是否使用密集前缀
+byte use_dense_prefix();
+
+// 统计对象覆盖的每个区域中的活动对象大小
+void count_region_live(object* obj);
+
+// 移动后对象的地址，密集前缀中的对象不移动
+object* forwarded(object* obj);
+
+// 原地清除，只清除标记，不移动对象
+void sweep_in_place();
+
 // 调整存活对象的引用指针
 void adjust_ref();
 
@@ -23,6 +51,98 @@ void move_obj();
 // 整理
 void compact();
 
+// Two-Finger：从两端向中间搜索，用活动对象填补前面的空闲单元
+void two_finger_move_obj();
+
+// Two-Finger：更新指向移动前对象的指针
+void two_finger_adjust_ref();
+
+// Two-Finger整理
+void two_finger_compact();
+
+/**
+ * @brief 间隙表格的表项
+ *  1. 记录对象群移动前的最低地址，以及它左边空闲空间的大小(移动距离)
+ *  2. 表项放在空闲空间中，对象至少有16字节，所以每段间隙都放得下一个8字节的表项
+ * 
+ */
+typedef struct break_entry {
+    int address;    // 对象群移动前的最低地址(相对位置)
+    int size;       // 对象群左边空闲空间的大小
+} break_entry;
+
+break_entry* break_table;   // 压缩结束后的间隙表格，位于堆中最后一个活动对象之后
+int break_table_len;        // 间隙表格的表项数
+
+unsigned long* mark_bitmap; // 标记位图，活动对象占用的每个GRANULE_SIZE都对应一位
+int* block_offsets;         // 偏移表，每个块之前所有活动对象的大小之和
+int num_blocks;             // 块数，也是标记位图的字数
+
+unsigned long* start_bitmap;    // 对象起始位图，并行整理时用来找出从区域中开始的对象
+int* region_offsets;            // 每个区域之前所有活动对象的大小之和
+byte* region_done;              // 区域中的对象是否已经移动完成
+int num_regions;                // 区域数
+int next_region;                // 下一个待处理的区域，线程通过原子操作领取
+int parallel_workers = 4;       // 并行整理的线程数
+
+int* region_live;               // 标记时统计的每个区域的活动对象大小
+int* region_first;              // 标记时记录的每个区域中第一个活动对象的位置，没有时为INT_MAX
+double sparse_threshold = 0;    // 选择性整理的活动比例阈值，0表示每次都完整整理
+byte full_compact = FALSE;      // 本次GC是否忽略密集前缀，完整整理
+int compact_start;              // 密集前缀的结束位置，从这里开始整理
+int compact_top;                // 整理后的free pointer
+
+// 表格算法：移动对象群并构建间隙表格
+void table_move_obj();
+
+// 表格算法：通过间隙表格重写指针
+void table_adjust_ref();
+
+// 表格算法：通过间隙表格计算对象新地址
+object* table_new_address(object* obj);
+
+// 表格算法整理
+void table_compact();
+
+// 位图算法：计算每个块之前的活动对象大小(偏移表)
+void bitmap_set_offsets();
+
+// 位图算法：通过标记位图和偏移表计算对象新地址
+object* bitmap_new_address(object* obj);
+
+// 位图算法：移动对象并更新引用
+void bitmap_move_obj();
+
+// 位图算法整理
+void bitmap_compact();
+
+// 并行整理：在多个线程中执行同一个阶段
+void parallel_run(void* (*phase)(void *));
+
+// 并行整理：统计每个块的活动对象大小
+void* parallel_count_blocks(void* arg);
+
+// 并行整理：计算区域内每个块的偏移
+void* parallel_set_offsets(void* arg);
+
+// 并行整理：移动区域中的对象，等待目标位置上的区域移动完成
+void* parallel_move_regions(void* arg);
+
+// 并行整理
+void parallel_compact();
+
+// 是否使用标记位图记录活动对象
+byte use_bitmap();
+
+// 对象是否已标记
+byte is_marked(object* obj);
+
+// 标记对象
+void set_marked(object* obj);
+
+// 对象在堆中占用的大小
+int obj_size(object* obj);
+
 // 标记
 void mark(object* obj);
 
@@ -41,18 +161,89 @@ int resolve_heap_size(int size) {
     return size;
 }
 
+void gc_set_compact_mode(compact_mode mode) {
+    gc_compact_mode = mode;
+}
+
+void gc_set_cell_size(int size) {
+    cell_size = size;
+}
+
+void gc_set_sparse_threshold(double ratio) {
+    sparse_threshold = ratio;
+}
+
+void gc_set_parallel_workers(int n) {
+    parallel_workers = n < 1 ? 1 : n > MAX_WORKERS ? MAX_WORKERS : n;
+}
+
+int obj_size(object* obj) {
+    return cell_size ? cell_size : obj->clss->size;
+}
+
 void gc_init(int size) {
+    if (gc_compact_mode == COMPACT_TWO_FINGER && !cell_size) {
+        printf("Two-Finger requires uniform cells, call gc_set_cell_size first\n");
+        abort();
+    }
+
+#ifdef COMPACT_NO_FORWARDING
+    if (gc_compact_mode == COMPACT_LISP2) {
+        printf("Lisp2 requires the forwarding field, rebuild without COMPACT_NO_FORWARDING\n");
+        abort();
+    }
+#endif
+
     heap_size = resolve_heap_size(size);
+    if (cell_size) {
+        heap_size = heap_size / cell_size * cell_size;
+    }
     heap = (void *) malloc(heap_size);
+    next_free_offset = 0;
+
+    if (use_bitmap()) {
+        num_blocks = (heap_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        mark_bitmap = (unsigned long *) calloc(num_blocks, sizeof(unsigned long));
+        block_offsets = (int *) malloc(num_blocks * sizeof(int));
+    }
+
+    num_regions = (heap_size + REGION_SIZE - 1) / REGION_SIZE;
+    region_live = (int *) calloc(num_regions, sizeof(int));
+    region_first = (int *) malloc(num_regions * sizeof(int));
+    for (int i = 0; i < num_regions; ++i) {
+        region_first[i] = INT_MAX;
+    }
+
+    if (gc_compact_mode == COMPACT_PARALLEL) {
+        start_bitmap = (unsigned long *) calloc(num_blocks, sizeof(unsigned long));
+        region_offsets = (int *) malloc((num_regions + 1) * sizeof(int));
+        region_done = (byte *) malloc(num_regions);
+    }
     _rp = 0;
 }
 
 object* gc_alloc(class_descriptor* clss) {
+    int size = cell_size ? cell_size : clss->size;
+    if (clss->size > size) {
+        printf("Allocation Failed! %s is larger than cell...\n", clss->name);
+        abort();
+    }
+
     // 检查是否可以分配
-    if (next_free_offset + clss->size > heap_size) {
-        printf("Allocation Failed. execute gc ...\n");
+    if (next_free_offset + size > heap_size) {
+        if (gc_verbose) {
+            printf("Allocation Failed. execute gc ...\n");
+        }
         gc();
-        if (next_free_offset + clss->size > heap_size) {
+
+        // 选择性整理留下的非活动对象不能分配，再完整整理一次
+        if (next_free_offset + size > heap_size && use_dense_prefix()) {
+            full_compact = TRUE;
+            gc();
+            full_compact = FALSE;
+        }
+
+        if (next_free_offset + size > heap_size) {
             printf("Allocation Failed! OutOfMemory...\n");
             abort();
         }
@@ -61,7 +252,7 @@ object* gc_alloc(class_descriptor* clss) {
     int old_offset = next_free_offset;
 
     // 分配后，free移动至下一个可分配位置
-    next_free_offset = next_free_offset + clss->size;
+    next_free_offset = next_free_offset + size;
 
     //分配
     object* new_obj = (object *) (old_offset + heap);
@@ -69,7 +260,9 @@ object* gc_alloc(class_descriptor* clss) {
     // 初始化
     new_obj->clss = clss;
     new_obj->marked = FALSE;
+#ifndef COMPACT_NO_FORWARDING
     new_obj->forwarding = NULL;
+#endif
 
     for (int i = 0; i < new_obj->clss->num_fields; ++i) {
         // *(data **)是一个dereference操作，拿到field的pointer
@@ -80,6 +273,14 @@ object* gc_alloc(class_descriptor* clss) {
     return new_obj;
 }
 
+#ifndef COMPACT_NO_FORWARDING
+object* forwarded(object* obj) {
+    if (!obj || (void *) obj < compact_start + heap) {
+        return obj;
+    }
+    return obj->forwarding;
+}
+
 /**
  * @brief 设定forwarding指针
  *  1. 程序首先会搜索整个堆，给活动对象设定forwarding指针
@@ -89,8 +290,8 @@ object* gc_alloc(class_descriptor* clss) {
  *  2. 因此在移动对象前，需要事先将各对象的指针全部更新到预计要移动到的地址
  */
 void set_forwarding() {
-    int scan = 0;           // scan 是用来搜索堆中的对象的指针
-    int new_address = 0;    // new_address 是指向目标地点的指针
+    int scan = compact_start;           // scan 是用来搜索堆中的对象的指针，密集前缀中的对象不移动，直接跳过
+    int new_address = compact_start;    // new_address 是指向目标地点的指针
 
     // 遍历堆的已使用部分，这里不用遍历全堆
     // 因为是顺序分配法，所以只需要遍历到已分配的终点即可
@@ -99,14 +300,16 @@ void set_forwarding() {
     while (scan < next_free_offset) {
         object* obj = (object *)(scan + heap);
 
-        // 为可达的对象设置forwarding
         if (obj->marked) {
+            // 为可达的对象设置forwarding
             obj->forwarding = (object *)(new_address + heap);
-            new_address = new_address + obj->clss->size;
+            new_address = new_address + obj_size(obj);
         }
 
-        scan = scan + obj->clss->size;
+        scan = scan + obj_size(obj);
     }
+
+    compact_top = new_address;
 }
 
 /**
@@ -118,11 +321,11 @@ void adjust_ref() {
 
     // 先将roots的引用更新。重写根的指针
     for (int i = 0; i < _rp; ++i) {
-        object* r_obj = _roots[i];
-        _roots[i] = r_obj->forwarding;
+        _roots[i] = forwarded(_roots[i]);
     }
 
     // 再遍历堆，更新存活对象的引用
+    // 密集前缀中的对象不移动，但可能引用后面移动的对象，所以也要遍历
     while (scan < next_free_offset) {
         object* obj = (object *)(scan + heap);
 
@@ -130,13 +333,16 @@ void adjust_ref() {
             // 更新引用为forwarding
             for (int i = 0; i < obj->clss->num_fields; ++i) {
                 object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
-                if ((*field) && (*field)->forwarding) {
-                    *field = (*field)->forwarding;
-                }
+                *field = forwarded(*field);
+            }
+
+            // 密集前缀中的对象不会被move_obj访问，在这里清除标记
+            if (scan < compact_start) {
+                obj->marked = FALSE;
             }
         }
 
-        scan = scan + obj->clss->size;
+        scan = scan + obj_size(obj);
     }
 }
 
@@ -146,20 +352,24 @@ void adjust_ref() {
  * 
  */
 void move_obj() {
-    int scan = 0;
-    int new_next_free_offset = 0;
+    int scan = compact_start;
+    int new_next_free_offset = compact_top;
 
     while (scan < next_free_offset) {
         object* obj = (object *) (scan + heap);
 
+        // 移动距离小于对象大小时，移动后原位置的对象头会被覆盖，所以先取得大小
+        int size = obj_size(obj);
+
         if (obj->marked) {
-            // 移动对象至forwarding
+            // 移动对象至forwarding，位置没有变化的对象不需要复制
             obj->marked = FALSE;
-            memcpy(obj->forwarding, obj, obj->clss->size);
-            new_next_free_offset = new_next_free_offset + obj->clss->size;
+            if (obj->forwarding != obj) {
+                memmove(obj->forwarding, obj, size);
+            }
         }
 
-        scan = scan + obj->clss->size;
+        scan = scan + size;
     }
 
     // 清空移动后的间隙
@@ -170,16 +380,574 @@ void move_obj() {
 }
 
 void compact() {
-    set_forwarding();
-    adjust_ref();
-    move_obj();
+    compact_start = use_dense_prefix() && !full_compact ? dense_prefix() : 0;
+
+    if (compact_start >= next_free_offset) {
+        sweep_in_place();
+    } else {
+        set_forwarding();
+        adjust_ref();
+        move_obj();
+    }
+}
+#endif
+
+byte use_dense_prefix() {
+    return gc_compact_mode == COMPACT_LISP2 && sparse_threshold > 0;
+}
+
+/**
+ * @brief 计算密集前缀
+ *  1. 从堆的开头起，找到第一个活动比例低于阈值的区域，它之前的区域都不需要整理
+ *  2. 区域边界可能位于对象中间，从前缀中最后一个有活动对象的区域里的第一个活动对象开始，向后找到边界之后的第一个对象
+ *  3. 返回值总是对象的起始位置，set_forwarding和move_obj直接从这里开始
+ * 
+ * @return int 密集前缀的结束位置
+ */
+int dense_prefix() {
+    int prefix = 0;
+    int i = 0;
+
+    for (; i < num_regions && prefix < next_free_offset; ++i) {
+        int end = (i + 1) * REGION_SIZE < next_free_offset ? (i + 1) * REGION_SIZE : next_free_offset;
+        if (region_live[i] < sparse_threshold * (end - i * REGION_SIZE)) {
+            break;
+        }
+        prefix = end;
+    }
+
+    if (prefix > 0 && prefix < next_free_offset) {
+        int scan = 0;
+        while (--i >= 0 && region_first[i] == INT_MAX) {}
+        if (i >= 0) {
+            scan = region_first[i];
+        }
+        while (scan < prefix) {
+            scan += obj_size((object *) (scan + heap));
+        }
+        prefix = scan;
+    }
+
+    if (gc_verbose) {
+        printf("dense prefix %d / %d\n", prefix, next_free_offset);
+    }
+    return prefix;
+}
+
+/**
+ * @brief 原地清除
+ *  1. 所有区域都足够密集时不移动任何对象，引用也不需要更新，只清除标记
+ * 
+ */
+void sweep_in_place() {
+    for (int scan = 0; scan < next_free_offset; scan += obj_size((object *) (scan + heap))) {
+        ((object *) (scan + heap))->marked = FALSE;
+    }
+}
+
+/**
+ * @brief Two-Finger移动对象
+ *  1. $free从前往后寻找非活动单元，live从后往前寻找活动对象
+ *  2. 找到后把live复制到$free，直到两个指针相遇
+ * @attention
+ *  1. 移动前的单元已经是空闲的，把forwarding指针写在它的第一个字里(覆盖clss)，不需要在对象头中准备forwarding域
+ *  2. 结束时next_free_offset更新为$free，所有活动对象都位于$free左边
+ */
+void two_finger_move_obj() {
+    int free = 0;
+    int live = next_free_offset - cell_size;
+
+    while (TRUE) {
+        // 从前往后寻找非活动对象
+        while (free < next_free_offset && ((object *) (free + heap))->marked) {
+            free += cell_size;
+        }
+
+        // 从后往前寻找活动对象
+        while (live >= 0 && !((object *) (live + heap))->marked) {
+            live -= cell_size;
+        }
+
+        if (free >= live) {
+            break;
+        }
+
+        object* src = (object *) (live + heap);
+        object* dst = (object *) (free + heap);
+        memcpy(dst, src, cell_size);
+        src->marked = FALSE;
+        *(object **) src = dst;
+    }
+
+    next_free_offset = free;
+}
+
+/**
+ * @brief Two-Finger更新指针
+ *  1. 位于$free右边的对象都已经移动过，通过移动前单元中记录的forwarding更新引用
+ *  2. 只需要遍历$free左边的活动对象
+ * 
+ */
+void two_finger_adjust_ref() {
+    void* boundary = next_free_offset + heap;
+
+    for (int i = 0; i < _rp; ++i) {
+        if ((void *) _roots[i] >= boundary) {
+            _roots[i] = *(object **) _roots[i];
+        }
+    }
+
+    for (int scan = 0; scan < next_free_offset; scan += cell_size) {
+        object* obj = (object *) (scan + heap);
+        obj->marked = FALSE;
+
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+            if ((void *) *field >= boundary) {
+                *field = *(object **) *field;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Two-Finger整理
+ *  1. 移动对象时，移动前的单元会保留到更新指针结束，所以移动前的对象不会被覆盖
+ *  2. 与Lisp2相比少一次堆的搜索，但不保留对象的顺序
+ * 
+ */
+void two_finger_compact() {
+    int old_next_free_offset = next_free_offset;
+
+    two_finger_move_obj();
+    two_finger_adjust_ref();
+
+    // 更新指针时还需要读取移动前单元里的forwarding，结束后再清空间隙
+    memset((void *) (next_free_offset + heap), 0, old_next_free_offset - next_free_offset);
+}
+
+/**
+ * @brief 表格算法移动对象群并构建间隙表格
+ *  1. 连续的活动对象构成一个对象群，整体向左滑动到$free，同时把(最低地址, 左边空闲空间大小)记录到间隙表格
+ *  2. 间隙表格始终紧跟在$free之后，对象群滑动时会覆盖表格开头的表项，所以按8字节逐块移动对象群，
+ *     每覆盖一个表项就先把它挪到表格末尾(表格的"回避"操作)
+ *  3. 表格末尾之后到对象群之间至少还有一个表项的空闲空间，所以挪动的表项不会覆盖还没有移动的对象
+ * @attention
+ *  1. 回避操作打乱了表项的顺序，结束后需要排序，重写指针时才能二分查找
+ * 
+ */
+void table_move_obj() {
+    int scan = 0;
+    int free = 0;
+    int size = 0;   // 对象群左边空闲空间的大小
+    int len = 0;    // 表项数，表格位于[free, free + len)
+
+    while (scan < next_free_offset) {
+        // 非活动对象
+        while (scan < next_free_offset && !((object *) (scan + heap))->marked) {
+            size += obj_size((object *) (scan + heap));
+            scan += obj_size((object *) (scan + heap));
+        }
+
+        if (scan >= next_free_offset) {
+            break;
+        }
+
+        // 对象群的第一个对象
+        int live = scan;
+        while (scan < next_free_offset && ((object *) (scan + heap))->marked) {
+            scan += obj_size((object *) (scan + heap));
+        }
+
+        if (size == 0) {
+            // 左边没有空闲空间，对象群不需要移动
+            free = scan;
+            continue;
+        }
+
+        // 按8字节滑动对象群，每次覆盖表格的第一个表项前，先把它挪到表格末尾
+        for (int p = 0; p < scan - live; p += sizeof(break_entry)) {
+            break_entry* first = (break_entry *) (free + p + heap);
+            break_entry entry = *first;
+            memcpy(first, live + p + heap, sizeof(break_entry));
+            if (len > 0) {
+                *(first + len) = entry;
+            }
+        }
+        free += scan - live;
+
+        // 在表格末尾记录这个对象群
+        break_entry* last = (break_entry *) (free + heap) + len;
+        last->address = live;
+        last->size = size;
+        len++;
+    }
+
+    break_table = (break_entry *) (free + heap);
+    break_table_len = len;
+    next_free_offset = free;
+}
+
+int break_entry_compare(const void* a, const void* b) {
+    return ((break_entry *) a)->address - ((break_entry *) b)->address;
+}
+
+/**
+ * @brief 通过间隙表格计算对象新地址
+ *  1. 找到最低地址小于等于obj的表项中地址最大的那个，原地址-移动距离=新地址
+ *  2. 没有这样的表项说明obj所在的对象群没有移动
+ * 
+ */
+object* table_new_address(object* obj) {
+    if (!obj) {
+        return NULL;
+    }
+
+    int address = (void *) obj - heap;
+    int low = 0, high = break_table_len - 1, best = -1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (break_table[mid].address <= address) {
+            best = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return best < 0 ? obj : (object *) ((void *) obj - break_table[best].size);
+}
+
+/**
+ * @brief 表格算法重写指针
+ *  1. 所有活动对象都已经位于$free左边，但它们的域还引用着移动前的地址
+ * 
+ */
+void table_adjust_ref() {
+    qsort(break_table, break_table_len, sizeof(break_entry), break_entry_compare);
+
+    for (int i = 0; i < _rp; ++i) {
+        _roots[i] = table_new_address(_roots[i]);
+    }
+
+    for (int scan = 0; scan < next_free_offset; scan += obj_size((object *) (scan + heap))) {
+        object* obj = (object *) (scan + heap);
+        obj->marked = FALSE;
+
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            object** field = (object **) ((void *) obj + obj->clss->field_offsets[i]);
+            *field = table_new_address(*field);
+        }
+    }
+}
+
+/**
+ * @brief 表格算法整理
+ *  1. 只需要2次搜索堆，而且保持对象的相对顺序
+ *  2. 间隙表格放在空闲空间里，不需要forwarding域
+ * 
+ */
+void table_compact() {
+    int old_next_free_offset = next_free_offset;
+
+    table_move_obj();
+    table_adjust_ref();
+
+    // 清空移动后的间隙，包括间隙表格
+    memset((void *) (next_free_offset + heap), 0, old_next_free_offset - next_free_offset);
+}
+
+byte use_bitmap() {
+    return gc_compact_mode == COMPACT_BITMAP || gc_compact_mode == COMPACT_PARALLEL;
+}
+
+byte is_marked(object* obj) {
+    if (!use_bitmap()) {
+        return obj->marked;
+    }
+
+    int granule = ((void *) obj - heap) / GRANULE_SIZE;
+    return (mark_bitmap[granule / 64] >> (granule % 64)) & 1;
+}
+
+/**
+ * @brief 标记对象
+ *  1. 位图算法把对象占用的所有粒度都记录到标记位图中，同一个块里对应位的个数就是活动对象的大小
+ * 
+ */
+void set_marked(object* obj) {
+    if (!use_bitmap()) {
+        obj->marked = TRUE;
+        return;
+    }
+
+    int first = ((void *) obj - heap) / GRANULE_SIZE;
+    if (gc_compact_mode == COMPACT_PARALLEL) {
+        start_bitmap[first / 64] |= 1UL << (first % 64);
+    }
+
+    int last = first + obj_size(obj) / GRANULE_SIZE;
+    for (int granule = first; granule < last; ++granule) {
+        mark_bitmap[granule / 64] |= 1UL << (granule % 64);
+    }
+}
+
+/**
+ * @brief 计算偏移表
+ *  1. 只读取标记位图，不需要访问堆
+ *  2. 每个块的活动对象大小互不依赖，可以分块并行统计，最后再求前缀和
+ * 
+ */
+void bitmap_set_offsets() {
+    int offset = 0;
+    for (int i = 0; i < num_blocks; ++i) {
+        block_offsets[i] = offset;
+        offset += __builtin_popcountl(mark_bitmap[i]) * GRANULE_SIZE;
+    }
+}
+
+/**
+ * @brief 计算对象新地址
+ *  1. 新地址 = 所在块的偏移 + 块内位于对象之前的活动对象大小
+ *  2. 块内的活动对象大小就是标记位图中对象之前的位数，不需要forwarding指针
+ * 
+ */
+object* bitmap_new_address(object* obj) {
+    if (!obj) {
+        return NULL;
+    }
+
+    int granule = ((void *) obj - heap) / GRANULE_SIZE;
+    unsigned long before = mark_bitmap[granule / 64] & ((1UL << (granule % 64)) - 1);
+    return (object *) (block_offsets[granule / 64] + __builtin_popcountl(before) * GRANULE_SIZE + heap);
+}
+
+/**
+ * @brief 移动对象
+ *  1. 按地址顺序遍历标记位图中的活动对象，把它移动到新地址后立刻更新它的引用
+ *  2. 新地址只由标记位图计算，不受移动的影响，所以一次遍历就能完成移动和更新
+ *  3. 新地址总是不大于原地址，按地址顺序移动不会覆盖还没有移动的对象
+ * 
+ */
+void bitmap_move_obj() {
+    for (int i = 0; i < _rp; ++i) {
+        _roots[i] = bitmap_new_address(_roots[i]);
+    }
+
+    int scan = 0;
+    while (scan < next_free_offset) {
+        int granule = scan / GRANULE_SIZE;
+        unsigned long word = mark_bitmap[granule / 64] >> (granule % 64);
+
+        // 跳过没有标记的粒度
+        if (!word) {
+            scan = (granule / 64 + 1) * BLOCK_SIZE;
+            continue;
+        }
+        if (!(word & 1)) {
+            scan += __builtin_ctzl(word) * GRANULE_SIZE;
+            continue;
+        }
+
+        // 对象群中的对象是连续的，按对象大小依次移动
+        object* obj = (object *) (scan + heap);
+        int size = obj_size(obj);
+        object* new_obj = bitmap_new_address(obj);
+
+        memmove(new_obj, obj, size);
+        for (int i = 0; i < new_obj->clss->num_fields; ++i) {
+            object** field = (object **) ((void *) new_obj + new_obj->clss->field_offsets[i]);
+            *field = bitmap_new_address(*field);
+        }
+
+        scan += size;
+    }
+}
+
+/**
+ * @brief 位图算法整理
+ *  1. 先根据标记位图计算偏移表，再移动一次对象，只读写一次堆，而且不会访问非活动对象
+ * 
+ */
+void bitmap_compact() {
+    bitmap_set_offsets();
+    bitmap_move_obj();
+
+    int new_next_free_offset = block_offsets[num_blocks - 1] + __builtin_popcountl(mark_bitmap[num_blocks - 1]) * GRANULE_SIZE;
+    memset((void *) (new_next_free_offset + heap), 0, next_free_offset - new_next_free_offset);
+    memset(mark_bitmap, 0, num_blocks * sizeof(unsigned long));
+
+    next_free_offset = new_next_free_offset;
+}
+
+/**
+ * @brief 在parallel_workers个线程中执行同一个阶段，全部结束后返回
+ * 
+ */
+void parallel_run(void* (*phase)(void *)) {
+    pthread_t workers[MAX_WORKERS];
+
+    next_region = 0;
+    for (int i = 0; i < parallel_workers; ++i) {
+        pthread_create(&workers[i], NULL, phase, NULL);
+    }
+    for (int i = 0; i < parallel_workers; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+// 领取下一个区域，没有剩余区域时返回-1
+int claim_region() {
+    int region = __atomic_fetch_add(&next_region, 1, __ATOMIC_SEQ_CST);
+    return region < num_regions ? region : -1;
+}
+
+/**
+ * @brief 统计每个块的活动对象大小
+ *  1. 先把块的活动对象大小写在block_offsets中，区域的合计写在region_offsets中，之后再转换为偏移
+ * 
+ */
+void* parallel_count_blocks(void* arg) {
+    (void) arg;
+    int blocks_per_region = REGION_SIZE / BLOCK_SIZE;
+
+    for (int region = claim_region(); region >= 0; region = claim_region()) {
+        int live = 0;
+        for (int i = region * blocks_per_region; i < (region + 1) * blocks_per_region && i < num_blocks; ++i) {
+            block_offsets[i] = __builtin_popcountl(mark_bitmap[i]) * GRANULE_SIZE;
+            live += block_offsets[i];
+        }
+        region_offsets[region] = live;
+        region_done[region] = FALSE;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 计算区域内每个块的偏移
+ *  1. 区域的偏移已经由前缀和得到，区域内的块只需要在区域偏移的基础上累加
+ * 
+ */
+void* parallel_set_offsets(void* arg) {
+    (void) arg;
+    int blocks_per_region = REGION_SIZE / BLOCK_SIZE;
+
+    for (int region = claim_region(); region >= 0; region = claim_region()) {
+        int offset = region_offsets[region];
+        for (int i = region * blocks_per_region; i < (region + 1) * blocks_per_region && i < num_blocks; ++i) {
+            int live = block_offsets[i];
+            block_offsets[i] = offset;
+            offset += live;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 移动区域中的对象
+ *  1. 区域负责移动从区域中开始的对象，新地址只由标记位图和偏移表计算，所以更新引用不依赖其他区域
+ *  2. 对象只会向低地址移动，区域的目标位置只可能覆盖编号更小的区域中还没有移动的对象
+ *  3. 所以移动前先等待目标位置所在的区域(以及可能跨进来的前一个区域)移动完成
+ *  4. 区域按编号顺序领取，等待的区域都已经被其他线程领取，不会死锁
+ * 
+ */
+void* parallel_move_regions(void* arg) {
+    (void) arg;
+    int blocks_per_region = REGION_SIZE / BLOCK_SIZE;
+
+    for (int region = claim_region(); region >= 0; region = claim_region()) {
+        // 等待目标位置上的区域，最后一个对象可能跨到下一个区域，目标位置的上限按下一个区域的结束计算
+        int low = region_offsets[region] / REGION_SIZE - 1;
+        int high = (region_offsets[region + 1 < num_regions ? region + 2 : num_regions] - 1) / REGION_SIZE;
+        for (int i = low < 0 ? 0 : low; i <= high && i < region; ++i) {
+            while (!__atomic_load_n(&region_done[i], __ATOMIC_ACQUIRE)) {
+                sched_yield();
+            }
+        }
+
+        for (int i = region * blocks_per_region; i < (region + 1) * blocks_per_region && i < num_blocks; ++i) {
+            for (unsigned long word = start_bitmap[i]; word; word &= word - 1) {
+                object* obj = (object *) ((i * 64 + __builtin_ctzl(word)) * GRANULE_SIZE + heap);
+                object* new_obj = bitmap_new_address(obj);
+
+                memmove(new_obj, obj, obj_size(obj));
+                for (int j = 0; j < new_obj->clss->num_fields; ++j) {
+                    object** field = (object **) ((void *) new_obj + new_obj->clss->field_offsets[j]);
+                    *field = bitmap_new_address(*field);
+                }
+            }
+        }
+
+        __atomic_store_n(&region_done[region], TRUE, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 并行整理
+ *  1. 堆被划分为固定大小的区域，各阶段都以区域为单位分给多个线程
+ *  2. 统计块的活动对象大小 -> 区域偏移的前缀和 -> 块的偏移 -> 移动对象并更新引用
+ *  3. 只有区域偏移的前缀和是串行的，它的长度只有区域数
+ * 
+ */
+void parallel_compact() {
+    parallel_run(parallel_count_blocks);
+
+    int offset = 0;
+    for (int i = 0; i < num_regions; ++i) {
+        int live = region_offsets[i];
+        region_offsets[i] = offset;
+        offset += live;
+    }
+    region_offsets[num_regions] = offset;
+
+    parallel_run(parallel_set_offsets);
+
+    for (int i = 0; i < _rp; ++i) {
+        _roots[i] = bitmap_new_address(_roots[i]);
+    }
+
+    parallel_run(parallel_move_regions);
+
+    memset((void *) (offset + heap), 0, next_free_offset - offset);
+    memset(mark_bitmap, 0, num_blocks * sizeof(unsigned long));
+    memset(start_bitmap, 0, num_blocks * sizeof(unsigned long));
+
+    next_free_offset = offset;
+}
+
+/**
+ * @brief 统计区域中的活动对象大小
+ *  1. 跨过区域边界的对象按它在每个区域中占用的字节数分别计入
+ *  2. 同时记录对象起始区域中第一个活动对象的位置，计算密集前缀时从这里找到对象边界
+ * 
+ */
+void count_region_live(object* obj) {
+    int start = (void *) obj - heap;
+    int end = start + obj_size(obj);
+
+    if (start < region_first[start / REGION_SIZE]) {
+        region_first[start / REGION_SIZE] = start;
+    }
+
+    for (int r = start / REGION_SIZE; r * REGION_SIZE < end; ++r) {
+        int low = r * REGION_SIZE > start ? r * REGION_SIZE : start;
+        int high = (r + 1) * REGION_SIZE < end ? (r + 1) * REGION_SIZE : end;
+        region_live[r] += high - low;
+    }
 }
 
 void mark(object* obj) {
-    if (!obj || obj->marked) { return; }
+    if (!obj || is_marked(obj)) { return; }
 
-    obj->marked = TRUE;
-    printf("marking...\n");
+    set_marked(obj);
+    if (use_dense_prefix()) {
+        count_region_live(obj);
+    }
+    if (gc_verbose) {
+        printf("marking...\n");
+    }
 
     // 递归标记对象的引用
     for (int i = 0; i < obj->clss->num_fields; ++i) {
@@ -188,10 +956,39 @@ void mark(object* obj) {
 }
 
 void gc() {
+    struct timespec start, end;
 
     for (int i = 0; i < _rp; ++i) {
         mark(_roots[i]);
     }
 
-    compact();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (gc_compact_mode == COMPACT_TWO_FINGER) {
+        two_finger_compact();
+    } else if (gc_compact_mode == COMPACT_TABLE) {
+        table_compact();
+    } else if (gc_compact_mode == COMPACT_BITMAP) {
+        bitmap_compact();
+    } else if (gc_compact_mode == COMPACT_PARALLEL) {
+        parallel_compact();
+    } else {
+#ifndef COMPACT_NO_FORWARDING
+        compact();
+#endif
+    }
+
+    if (use_dense_prefix()) {
+        memset(region_live, 0, num_regions * sizeof(int));
+        for (int i = 0; i < num_regions; ++i) {
+            region_first[i] = INT_MAX;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    gc_compact_time += (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+int gc_num_roots() {
+    return _rp;
 }
\ No newline at end of file
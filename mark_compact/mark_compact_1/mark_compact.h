@@ -24,12 +24,37 @@ typedef struct _object object;
 struct _object {
     class_descriptor* clss; // 对象对应的类型
     byte marked;            // 是否可达
+#ifndef COMPACT_NO_FORWARDING
     object* forwarding;     // 目标位置.相当于链表
+#endif
 };
 
 #define MAX_ROOTS 100
 #define MAX_HEAP_SIZE 1024 * 1024 * 10   // 10MB
 
+/**
+ * @brief 压缩算法
+ *  1. 定义COMPACT_NO_FORWARDING编译时，对象头中不再有forwarding域，每个对象节省8字节
+ *  2. 此时只能使用不依赖forwarding域的算法，默认使用表格算法
+ * 
+ */
+typedef enum {
+    COMPACT_LISP2,      // Lisp2算法，3次搜索堆，支持任意大小的对象，需要对象头中的forwarding域
+    COMPACT_TWO_FINGER, // Two-Finger算法，2次搜索堆，要求堆中的对象大小一致(见gc_set_cell_size)
+    COMPACT_TABLE,      // 表格算法，2次搜索堆，间隙表格记录在空闲空间中，不需要forwarding域
+    COMPACT_BITMAP,     // 位图+偏移表(Compressor)，根据标记位图计算新地址，只移动一次对象，不需要forwarding域
+    COMPACT_PARALLEL    // 按区域并行的位图整理，多个线程同时移动不同区域的对象
+} compact_mode;
+
+#define GRANULE_SIZE 8  // 标记位图中每一位对应的堆大小(B)
+
+#define BLOCK_SIZE 512  // 偏移表中每个块的大小(B)，正好对应标记位图中的一个字(64位)
+
+#define REGION_SIZE 4096    // 并行整理时每个区域的大小(B)，区域是线程之间分配任务的单位
+
+#define MAX_WORKERS 16      // 并行整理的最大线程数
+
+
 const static byte TRUE = 1;
 const static byte FALSE = 0;
 
@@ -42,6 +67,15 @@ extern int _rp;
 // 堆总大小
 extern int heap_size;
 
+// 当前的压缩算法
+extern compact_mode gc_compact_mode;
+
+// 是否打印GC过程日志
+extern byte gc_verbose;
+
+// 累计的压缩阶段耗时(ms)
+extern double gc_compact_time;
+
 /**
  * @brief 初始化GC
  * 
@@ -49,6 +83,40 @@ extern int heap_size;
  */
 extern void gc_init(int size);
 
+/**
+ * @brief 设置压缩算法，需要在gc_init之前调用
+ * 
+ * @param mode 压缩算法
+ */
+extern void gc_set_compact_mode(compact_mode mode);
+
+/**
+ * @brief 设置统一的单元大小，需要在gc_init之前调用
+ *  1. 设置后每次分配都占用一个单元，对象大小不能超过单元大小
+ *  2. Two-Finger算法要求对象大小一致，必须设置单元大小
+ * 
+ * @param size 单元大小，0表示按对象实际大小分配
+ */
+extern void gc_set_cell_size(int size);
+
+/**
+ * @brief 设置选择性整理的阈值，仅用于Lisp2
+ *  1. 标记时按REGION_SIZE统计每个区域的活动对象大小
+ *  2. 从堆的开头起，活动比例不低于阈值的区域构成"密集前缀"，原地清除，不移动对象
+ *  3. 只整理第一个稀疏区域之后的部分；整个堆都密集时完全跳过移动
+ *  4. 原地清除的区域里的非活动对象不能重新分配，分配失败时再执行一次完整的整理
+ * 
+ * @param ratio 活动比例阈值(0~1)，0表示每次都完整整理
+ */
+extern void gc_set_sparse_threshold(double ratio);
+
+/**
+ * @brief 设置并行整理的线程数
+ * 
+ * @param n 线程数，不超过MAX_WORKERS
+ */
+extern void gc_set_parallel_workers(int n);
+
 /**
  * @brief 执行GC
  * 
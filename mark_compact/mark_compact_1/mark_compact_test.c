@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include "mark_compact.h"
 
 #define MAX_ROOTS 100
@@ -8,18 +9,41 @@
 typedef struct dept {
     class_descriptor* clss; // 对象对应的类型
     byte marked;            // 是否可达
+#ifndef COMPACT_NO_FORWARDING
     object* forwarding;     // 目标位置
+#endif
     int id;
 } dept;
 
 typedef struct emp {
     class_descriptor* clss; // 对象对应的类型
     byte marked;            // 是否可达
+#ifndef COMPACT_NO_FORWARDING
     object* forwarding;     // 目标位置
+#endif
     int id;
     dept* dept;
 } emp;
 
+typedef struct link {
+    class_descriptor* clss; // 对象对应的类型
+    byte marked;            // 是否可达
+#ifndef COMPACT_NO_FORWARDING
+    object* forwarding;     // 目标位置
+#endif
+    int id;
+    struct link* next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
 class_descriptor emp_object_class = {
     "emp_object",
     sizeof(struct emp),
@@ -36,8 +60,8 @@ class_descriptor dept_object_class = {
     NULL
 };
 
-int main(int argc, char *argv[]) {
-
+// 测试默认的压缩算法，第3轮循环时内存溢出
+void test_compact() {
     gc_init((emp_object_class.size + dept_object_class.size) * 3);
 
     for (int i = 0; i < 4; ++i) {
@@ -57,4 +81,264 @@ int main(int argc, char *argv[]) {
         _emp2->dept = _dept2;
 
     }
+}
+
+/**
+ * @brief 按emp/dept的形状填充堆，每个emp都引用一个dept，每隔step个emp保留一个到GC ROOTS
+ *  1. 分配dept时可能触发GC移动emp，所以通过GC ROOTS重新取得emp
+ *  2. 只使用调用时_rp之后的GC ROOTS，之前的不受影响
+ * 
+ * @param count 分配的emp数量
+ * @param step 保留的间隔
+ */
+void fill_emp_dept(int count, int step) {
+    int base = _rp;
+
+    for (int i = 0; i < count; ++i) {
+        int slot = base + (i / step) % (MAX_ROOTS - base);
+        emp* _emp = (emp *) gc_alloc(&emp_object_class);
+        _emp->id = i;
+
+        if (i % step == 0) {
+            if (_rp < MAX_ROOTS) {
+                gc_add_root(_emp);
+            } else {
+                _roots[slot] = (object *) _emp;
+            }
+        }
+
+        dept* _dept = (dept *) gc_alloc(&dept_object_class);
+        _dept->id = i;
+
+        if (i % step == 0) {
+            ((emp *) _roots[slot])->dept = _dept;
+        }
+    }
+}
+
+// 检查从base开始的GC ROOTS引用的emp和dept在整理后是否还匹配
+int check_roots(int base) {
+    for (int i = base; i < _rp; ++i) {
+        emp* _emp = (emp *) _roots[i];
+        if (_emp->clss != &emp_object_class || !_emp->dept || _emp->dept->id != _emp->id) {
+            printf("root %d is broken\n", i);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// 测试Two-Finger整理，emp/dept统一放在emp大小的单元中
+void test_two_finger() {
+    compact_mode mode = gc_compact_mode;
+    gc_set_compact_mode(COMPACT_TWO_FINGER);
+    gc_set_cell_size(emp_object_class.size);
+    gc_init(emp_object_class.size * 24);
+
+    fill_emp_dept(40, 5);
+    if (!check_roots(0)) {
+        printf("two-finger compaction broke roots!\n");
+        abort();
+    }
+
+    gc_set_compact_mode(mode);
+    gc_set_cell_size(0);
+}
+
+/**
+ * @brief 创建一条长期存活的链表，放在GC ROOTS的第一个位置
+ *  1. 链表是从尾部开始创建的，分配时可能触发GC移动已创建的部分，所以通过GC ROOTS取得链表头
+ * 
+ */
+void make_list(int count) {
+    gc_add_root(NULL);
+    for (int i = 0; i < count; ++i) {
+        link* _link = (link *) gc_alloc(&link_object_class);
+        _link->id = i;
+        _link->next = (link *) _roots[_rp - 1];
+        _roots[_rp - 1] = (object *) _link;
+    }
+}
+
+/**
+ * @brief 从链表中删除一部分节点，删除的节点成为分散在链表中的垃圾
+ * 
+ * @param every 删除的间隔
+ * @param phase 删除的起始位置
+ * @return int 删除的节点数
+ */
+int drop_links(int every, int phase) {
+    int n = 0, dropped = 0;
+    for (link* _link = (link *) _roots[0]; _link && _link->next; _link = _link->next) {
+        if (++n % every == phase) {
+            _link->next = _link->next->next;
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+// 检查链表是否完整，节点按id降序排列
+int check_list(int count) {
+    int n = 0;
+    for (link* _link = (link *) _roots[0]; _link; _link = _link->next) {
+        if (_link->next && _link->next->id >= _link->id) {
+            return FALSE;
+        }
+        n++;
+    }
+    return n == count;
+}
+
+// 测试选择性整理，长期存活的链表位于堆的开头，不会被移动
+void test_sparse() {
+    gc_set_sparse_threshold(0.8);
+    gc_init(REGION_SIZE * 8);
+
+    make_list(400);
+    object* head = _roots[0];
+    fill_emp_dept(4000, 7);
+
+    if (!check_list(400)) {
+        printf("sparse compaction broke the list!\n");
+        abort();
+    }
+    if (!check_roots(1)) {
+        printf("sparse compaction broke roots!\n");
+        abort();
+    }
+    // 链表都在密集前缀中，GC之后还在原来的位置
+    if (_roots[0] != head) {
+        printf("list in the dense prefix is moved!\n");
+        abort();
+    }
+
+    gc_set_sparse_threshold(0);
+}
+
+// 测试表格算法整理，emp/dept按实际大小分配
+void test_table() {
+    compact_mode mode = gc_compact_mode;
+    gc_set_compact_mode(COMPACT_TABLE);
+    gc_init((emp_object_class.size + dept_object_class.size) * 12);
+
+    fill_emp_dept(40, 5);
+    if (!check_roots(0)) {
+        printf("table compaction broke roots!\n");
+        abort();
+    }
+
+    gc_set_compact_mode(mode);
+}
+
+// 测试位图算法整理，emp/dept按实际大小分配
+void test_bitmap() {
+    compact_mode mode = gc_compact_mode;
+    gc_set_compact_mode(COMPACT_BITMAP);
+    gc_init((emp_object_class.size + dept_object_class.size) * 12);
+
+    fill_emp_dept(40, 5);
+    if (!check_roots(0)) {
+        printf("bitmap compaction broke roots!\n");
+        abort();
+    }
+
+    gc_set_compact_mode(mode);
+}
+
+// 测试并行整理，区域比堆小，对象会跨区域移动
+void test_parallel() {
+    compact_mode mode = gc_compact_mode;
+    gc_set_compact_mode(COMPACT_PARALLEL);
+    gc_set_parallel_workers(4);
+    gc_init(REGION_SIZE * 4);
+
+    fill_emp_dept(2000, 7);
+    if (!check_roots(0)) {
+        printf("parallel compaction broke roots!\n");
+        abort();
+    }
+
+    gc_set_compact_mode(mode);
+}
+
+// 在同样的emp/dept形状上，对比压缩算法的耗时
+void benchmark(compact_mode mode, char* name) {
+    compact_mode default_mode = gc_compact_mode;
+    gc_verbose = FALSE;
+    gc_compact_time = 0;
+    gc_set_compact_mode(mode);
+    gc_set_cell_size(emp_object_class.size);
+    gc_init(MAX_HEAP_SIZE);
+
+    fill_emp_dept(2000000, 97);
+
+    if (!check_roots(0)) {
+        printf("%s compaction broke roots!\n", name);
+        abort();
+    }
+    printf("%-12s compact %8.2f ms\n", name, gc_compact_time);
+
+    gc_set_compact_mode(default_mode);
+    gc_set_cell_size(0);
+    gc_verbose = TRUE;
+}
+
+#ifndef COMPACT_NO_FORWARDING
+// 堆的前半部分是长期存活的链表，每轮都有少量节点死亡，对比完整整理和选择性整理的耗时
+void benchmark_sparse(double ratio, char* name) {
+    int count = MAX_HEAP_SIZE / 2 / link_object_class.size;
+
+    gc_verbose = FALSE;
+    gc_compact_time = 0;
+    gc_set_sparse_threshold(ratio);
+    gc_init(MAX_HEAP_SIZE);
+
+    make_list(count);
+    for (int round = 0; round < 8; ++round) {
+        count -= drop_links(64, round);
+        _rp = 1;
+        fill_emp_dept(100000, 97);
+    }
+
+    if (!check_list(count) || !check_roots(1)) {
+        printf("%s compaction broke the list or roots!\n", name);
+        abort();
+    }
+    printf("%-12s compact %8.2f ms\n", name, gc_compact_time);
+
+    gc_set_sparse_threshold(0);
+    gc_verbose = TRUE;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+#ifndef COMPACT_NO_FORWARDING
+        benchmark(COMPACT_LISP2, "lisp2");
+#endif
+        benchmark(COMPACT_TWO_FINGER, "two-finger");
+        benchmark(COMPACT_TABLE, "table");
+        benchmark(COMPACT_BITMAP, "bitmap");
+        for (int n = 1; n <= 8; n *= 2) {
+            char name[32];
+            sprintf(name, "parallel-%d", n);
+            gc_set_parallel_workers(n);
+            benchmark(COMPACT_PARALLEL, name);
+        }
+#ifndef COMPACT_NO_FORWARDING
+        benchmark_sparse(0, "lisp2-full");
+        benchmark_sparse(0.8, "lisp2-sparse");
+#endif
+        return 0;
+    }
+
+    test_two_finger();
+    test_table();
+    test_bitmap();
+    test_parallel();
+#ifndef COMPACT_NO_FORWARDING
+    test_sparse();
+#endif
+    test_compact();
 }
\ No newline at end of file
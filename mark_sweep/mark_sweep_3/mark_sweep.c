@@ -56,7 +56,7 @@ node* find_idle_node() {
         gc();
     }
 
-    for (next_free = head->next; next_free && next_free->used; next_free = next_free->next) {}
+    for (next_free = head; next_free && next_free->used; next_free = next_free->next) {}
 
     //再找不到真的没了……
     if (!next_free) {
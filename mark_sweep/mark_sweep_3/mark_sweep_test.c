@@ -36,7 +36,25 @@ class_descriptor dept_object_class = {
     NULL
 };
 
+// 测试GC之后只有链表头的单元是空闲的，也能分配
+void test_reuse_head() {
+    gc_init(NODE_SIZE * 2);
+
+    // 第一个对象分配在链表头的单元中，GC时被回收
+    dept *garbage = (dept *) gc_alloc(&dept_object_class);
+    dept *_dept1 = (dept *) gc_alloc(&dept_object_class);
+    gc_add_root(_dept1);
+
+    dept *_dept2 = (dept *) gc_alloc(&dept_object_class);
+    if (_dept2 != garbage) {
+        printf("free head node is not reused!\n");
+        abort();
+    }
+}
+
 int main(int argc, char *argv[]) {
+    test_reuse_head();
+
     gc_init(256 * 3);
 
     for (int i = 0; i < 3; ++i) {
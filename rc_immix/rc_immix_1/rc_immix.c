@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "rc_immix.h"
+
+object* _roots[MAX_ROOTS];
+int _rp;
+
+void* heap_start;
+int heap_size;
+int num_lines;
+byte* line_cnt;
+byte* line_marks;       // 积极的碎片整理时重新计算的线的计数器
+
+void* cursor;           // 当前空洞中下一个空闲位置
+void* limit;            // 当前空洞的结尾
+int next_line;          // 下一次从这条线开始找空洞
+
+/**
+ * @brief 修改缓冲区
+ *  1. 每一项是一个对象，后面跟着它第一次被修改之前所有属性的值
+ *
+ */
+object** mod_buf;
+int mod_buf_top;        // 修改缓冲区中已经使用的大小
+int mod_buf_capacity;
+int mod_buf_count;      // 修改缓冲区中记录的对象数
+
+object* prev_roots[MAX_ROOTS];  // 上一次GC时的GC ROOTS
+int prev_rp;
+
+object** stack;         // 搜索对象用的栈
+int sp;
+int stack_capacity;
+
+byte* defrag_blocks;    // 积极的碎片整理时，要把对象复制出去的块
+byte mark_epoch;        // 每次积极的碎片整理开始时翻转，对象的marked和它相同表示已标记
+
+int collections;        // GC次数
+int defrags;            // 积极的碎片整理次数
+int copied_bytes;       // 复制的对象总大小
+int reclaimed_objects;  // 回收的对象数
+
+/**
+ * @brief 对象大小，按8字节对齐
+ *
+ * @param clss
+ * @return int
+ */
+int object_size(class_descriptor* clss);
+
+/**
+ * @brief 从next_line开始找能放下size的空洞
+ *  1. 空洞是同一个块中连续的计数器为0的线
+ *  2. 积极的碎片整理时跳过要整理的块
+ *
+ * @param size
+ * @return byte 找不到时返回FALSE
+ */
+byte find_hole(int size);
+
+/**
+ * @brief 在当前空洞中顺序分配，放不下时找下一个空洞
+ *
+ * @param size
+ * @return void* 找不到空洞时返回NULL
+ */
+void* bump(int size);
+
+/**
+ * @brief 对象所在的每一条线的计数器加上delta
+ *
+ * @param counts 线的计数器
+ * @param obj
+ * @param delta
+ */
+void count_lines(byte* counts, object* obj, int delta);
+
+void push(object* obj);
+
+/**
+ * @brief 增加计数，计数器达到STICKY_RC后不再变化
+ *
+ * @param obj
+ */
+void inc_ref_cnt(object* obj);
+
+/**
+ * @brief 减少计数，计数器变为0的对象压栈，由release_all回收
+ *
+ * @param obj
+ */
+void dec_ref_cnt(object* obj);
+
+/**
+ * @brief 回收栈中的对象，减少它们引用的对象和所在的线的计数器
+ *
+ */
+void release_all();
+
+/**
+ * @brief 把对象和它所有属性的当前值记录到修改缓冲区中
+ *
+ * @param obj
+ */
+void mod_buf_register(object* obj);
+
+/**
+ * @brief 对属性引用的对象计数
+ *  1. 引用的对象已经被复制时，修改属性
+ *  2. 引用的是新对象时，先把它变成旧对象
+ *
+ * @param field_ref
+ */
+void inc_field(object** field_ref);
+
+/**
+ * @brief 新对象第一次被计数时变成旧对象
+ *  1. 能在空闲的线中放下时复制过去(被动的碎片整理)，否则留在原地
+ *  2. 增加它所在的线的计数器，压栈之后计数它引用的对象
+ *
+ * @param obj
+ * @return object* 变成旧对象之后的位置
+ */
+object* promote(object* obj);
+
+/**
+ * @brief 积极的碎片整理时搜索属性引用的对象
+ *  1. 第一次搜索到的对象，在要整理的块中时复制出去，重新计算它所在的线的计数器
+ *  2. 每搜索到一次，计数器加1
+ *
+ * @param field_ref
+ */
+void trace_field(object** field_ref);
+
+int object_size(class_descriptor* clss) {
+    return (clss->size + 7) / 8 * 8;
+}
+
+byte find_hole(int size) {
+    while (next_line < num_lines) {
+        // 跳过有活动对象的线，以及要整理的块
+        while (next_line < num_lines
+                && (line_cnt[next_line] > 0 || (defrag_blocks && defrag_blocks[next_line / LINES_PER_BLOCK]))) {
+            next_line++;
+        }
+        if (next_line >= num_lines) {
+            break;
+        }
+
+        // 空洞不跨越块
+        int start = next_line;
+        int block_end = (start / LINES_PER_BLOCK + 1) * LINES_PER_BLOCK;
+        while (next_line < block_end && line_cnt[next_line] == 0) {
+            next_line++;
+        }
+
+        if ((next_line - start) * LINE_SIZE >= size) {
+            cursor = heap_start + start * LINE_SIZE;
+            limit = heap_start + next_line * LINE_SIZE;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void* bump(int size) {
+    if (!cursor || cursor + size > limit) {
+        if (!find_hole(size)) {
+            return NULL;
+        }
+    }
+
+    void* p = cursor;
+    cursor += size;
+    return p;
+}
+
+void count_lines(byte* counts, object* obj, int delta) {
+    int first = gc_line_of(obj);
+    int last = gc_line_of((void *) obj + object_size(obj->clss) - 1);
+    for (int i = first; i <= last; ++i) {
+        counts[i] += delta;
+    }
+}
+
+void push(object* obj) {
+    if (sp == stack_capacity) {
+        stack_capacity = stack_capacity ? stack_capacity * 2 : 256;
+        stack = (object **) realloc(stack, stack_capacity * sizeof(object *));
+    }
+    stack[sp++] = obj;
+}
+
+void inc_ref_cnt(object* obj) {
+    if (obj->ref_cnt < STICKY_RC) {
+        obj->ref_cnt++;
+    }
+}
+
+void dec_ref_cnt(object* obj) {
+    if (!obj || obj->ref_cnt == STICKY_RC) {
+        return;
+    }
+
+    if (--obj->ref_cnt == 0) {
+        push(obj);
+    }
+}
+
+void release_all() {
+    // 用栈代替递归，很长的链表也不会栈溢出
+    while (sp > 0) {
+        object* obj = stack[--sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            dec_ref_cnt(*((object **) ((void *) obj + obj->clss->field_offsets[i])));
+        }
+
+        // 线中没有活动对象之后，整条线在下一次分配时重新使用
+        count_lines(line_cnt, obj, -1);
+        reclaimed_objects++;
+
+#ifdef DO_DEBUG
+        memset(obj, 0, obj->clss->size);
+#endif
+    }
+}
+
+void mod_buf_register(object* obj) {
+    int need = 1 + obj->clss->num_fields;
+    if (mod_buf_top + need > mod_buf_capacity) {
+        mod_buf_capacity = mod_buf_capacity ? mod_buf_capacity * 2 : MOD_BUF_SIZE * 4;
+        if (mod_buf_capacity < mod_buf_top + need) {
+            mod_buf_capacity = mod_buf_top + need;
+        }
+        mod_buf = (object **) realloc(mod_buf, mod_buf_capacity * sizeof(object *));
+    }
+
+    mod_buf[mod_buf_top++] = obj;
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        mod_buf[mod_buf_top++] = *((object **) ((void *) obj + obj->clss->field_offsets[i]));
+    }
+    mod_buf_count++;
+    obj->dirty = TRUE;
+}
+
+object* promote(object* obj) {
+    int size = object_size(obj->clss);
+
+    // 在当前空洞之后的空闲线中分配，这些线在这次GC之前没有被使用过
+    object* copy = (object *) bump(size);
+    if (copy) {
+        memcpy(copy, obj, size);
+        obj->forwarded = TRUE;
+        obj->forwarding = copy;
+        copied_bytes += size;
+    } else {
+        copy = obj;
+    }
+
+    copy->old = TRUE;
+    copy->forwarded = FALSE;
+    copy->ref_cnt = 0;
+    count_lines(line_cnt, copy, 1);
+    push(copy);
+
+    return copy;
+}
+
+void inc_field(object** field_ref) {
+    object* obj = *field_ref;
+    if (!obj) {
+        return;
+    }
+
+    if (obj->forwarded) {
+        obj = obj->forwarding;
+    } else if (!obj->old) {
+        obj = promote(obj);
+    }
+
+    *field_ref = obj;
+    inc_ref_cnt(obj);
+}
+
+void trace_field(object** field_ref) {
+    object* obj = *field_ref;
+    if (!obj) {
+        return;
+    }
+
+    if (obj->forwarded) {
+        obj = obj->forwarding;
+    } else if (obj->marked != mark_epoch) {
+        int size = object_size(obj->clss);
+        object* copy = defrag_blocks[gc_line_of(obj) / LINES_PER_BLOCK] ? (object *) bump(size) : NULL;
+        if (copy) {
+            memcpy(copy, obj, size);
+            obj->forwarded = TRUE;
+            obj->forwarding = copy;
+            copied_bytes += size;
+            obj = copy;
+        }
+
+        obj->marked = mark_epoch;
+        obj->forwarded = FALSE;
+        obj->ref_cnt = 0;
+        count_lines(line_marks, obj, 1);
+        push(obj);
+    }
+
+    *field_ref = obj;
+    inc_ref_cnt(obj);
+}
+
+void gc_init(int size) {
+    if (size > MAX_HEAP_SIZE) {
+        size = MAX_HEAP_SIZE;
+    }
+    heap_size = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    if (heap_size == 0) {
+        heap_size = BLOCK_SIZE;
+    }
+
+    heap_start = malloc(heap_size);
+    num_lines = heap_size / LINE_SIZE;
+    line_cnt = (byte *) calloc(num_lines, 1);
+    line_marks = (byte *) calloc(num_lines, 1);
+    defrag_blocks = NULL;
+
+    cursor = NULL;
+    limit = NULL;
+    next_line = 0;
+
+    _rp = 0;
+    prev_rp = 0;
+    mod_buf_top = 0;
+    mod_buf_count = 0;
+    sp = 0;
+    mark_epoch = 0;
+
+    collections = 0;
+    defrags = 0;
+    copied_bytes = 0;
+    reclaimed_objects = 0;
+}
+
+void gc() {
+    printf("rc collection ...\n");
+    collections++;
+
+    // 增量：GC ROOTS和修改缓冲区中的对象现在引用的对象
+    for (int i = 0; i < _rp; ++i) {
+        inc_field(&_roots[i]);
+    }
+
+    for (int top = 0; top < mod_buf_top; ) {
+        object* obj = mod_buf[top];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            inc_field((object **) ((void *) obj + obj->clss->field_offsets[i]));
+        }
+        obj->dirty = FALSE;
+        top += 1 + obj->clss->num_fields;
+    }
+
+    // 变成旧对象的新对象，它引用的对象也要计数
+    while (sp > 0) {
+        object* obj = stack[--sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            inc_field((object **) ((void *) obj + obj->clss->field_offsets[i]));
+        }
+    }
+
+    // 减量：上一次GC时的GC ROOTS和修改缓冲区中记录的旧值引用的对象
+    for (int i = 0; i < prev_rp; ++i) {
+        dec_ref_cnt(prev_roots[i]);
+    }
+
+    for (int top = 0; top < mod_buf_top; ) {
+        object* obj = mod_buf[top++];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            dec_ref_cnt(mod_buf[top++]);
+        }
+    }
+    mod_buf_top = 0;
+    mod_buf_count = 0;
+
+    release_all();
+
+    // 这次GC时的GC ROOTS，下一次GC时减掉它们的计数
+    memcpy(prev_roots, _roots, _rp * sizeof(object *));
+    prev_rp = _rp;
+
+    // 新对象都处理完了，从头开始找空洞
+    cursor = NULL;
+    limit = NULL;
+    next_line = 0;
+}
+
+void gc_defrag() {
+    gc();
+
+    printf("defrag ...\n");
+    defrags++;
+
+    // 选出活动线比例低的块
+    int num_blocks = heap_size / BLOCK_SIZE;
+    defrag_blocks = (byte *) calloc(num_blocks, 1);
+    for (int b = 0; b < num_blocks; ++b) {
+        int live = 0;
+        for (int i = b * LINES_PER_BLOCK; i < (b + 1) * LINES_PER_BLOCK; ++i) {
+            live += line_cnt[i] > 0;
+        }
+        defrag_blocks[b] = live > 0 && live * 100 <= LINES_PER_BLOCK * DEFRAG_THRESHOLD;
+    }
+
+    // 从GC ROOTS开始搜索，重新计算计数器
+    mark_epoch = !mark_epoch;
+    memset(line_marks, 0, num_lines);
+
+    for (int i = 0; i < _rp; ++i) {
+        trace_field(&_roots[i]);
+    }
+
+    while (sp > 0) {
+        object* obj = stack[--sp];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            trace_field((object **) ((void *) obj + obj->clss->field_offsets[i]));
+        }
+    }
+
+    // 没有搜索到的对象所在的线计数器为0
+    byte* counts = line_cnt;
+    line_cnt = line_marks;
+    line_marks = counts;
+
+    free(defrag_blocks);
+    defrag_blocks = NULL;
+
+    memcpy(prev_roots, _roots, _rp * sizeof(object *));
+    prev_rp = _rp;
+
+    cursor = NULL;
+    limit = NULL;
+    next_line = 0;
+}
+
+void gc_done() {
+    free(heap_start);
+    free(line_cnt);
+    free(line_marks);
+    heap_start = NULL;
+    line_cnt = NULL;
+    line_marks = NULL;
+}
+
+object* gc_alloc(class_descriptor* clss) {
+    int size = object_size(clss);
+    if (size > BLOCK_SIZE) {
+        printf("Object is too large!\n");
+        abort();
+    }
+
+    object* new_obj = (object *) bump(size);
+
+    // 找不到空洞就执行GC，还不够就执行积极的碎片整理
+    if (!new_obj) {
+        gc();
+        new_obj = (object *) bump(size);
+    }
+
+    if (!new_obj) {
+        gc_defrag();
+        new_obj = (object *) bump(size);
+    }
+
+    //再找不到真的没了……
+    if (!new_obj) {
+        printf("Allocation Failed!OutOfMemory...\n");
+        abort();
+    }
+
+    new_obj->clss = clss;
+    new_obj->ref_cnt = 0;
+    new_obj->dirty = FALSE;
+    new_obj->old = FALSE;
+    new_obj->forwarded = FALSE;
+    new_obj->marked = mark_epoch;
+    new_obj->forwarding = NULL;
+
+    for (int i = 0; i < clss->num_fields; ++i) {
+        *(object **) ((void *) new_obj + clss->field_offsets[i]) = NULL;
+    }
+
+    return new_obj;
+}
+
+void gc_update_ptr(object* obj, object** field_ref, object* new_obj) {
+    if (obj->old && !obj->dirty) {
+        // 修改缓冲区满了就先执行GC，GC可能会复制new_obj，暂存在GC ROOTS中
+        if (mod_buf_count >= MOD_BUF_SIZE) {
+            gc_save_rp;
+            gc_add_root(new_obj);
+            gc();
+            new_obj = _roots[__rp];
+            gc_restore_roots;
+        }
+        mod_buf_register(obj);
+    }
+
+    *field_ref = new_obj;
+}
+
+int gc_line_of(void* obj) {
+    return (obj - heap_start) / LINE_SIZE;
+}
+
+int gc_free_lines() {
+    int free_lines = 0;
+    for (int i = 0; i < num_lines; ++i) {
+        free_lines += line_cnt[i] == 0;
+    }
+
+    return free_lines;
+}
+
+char *gc_get_state() {
+    int num_blocks = heap_size / BLOCK_SIZE;
+    int free_blocks = 0;
+    for (int b = 0; b < num_blocks; ++b) {
+        int used = 0;
+        for (int i = b * LINES_PER_BLOCK; i < (b + 1) * LINES_PER_BLOCK; ++i) {
+            used += line_cnt[i] > 0;
+        }
+        free_blocks += used == 0;
+    }
+
+    printf("Heap Usage:\n");
+    printf("   blocks      = %d (%d free)\n", num_blocks, free_blocks);
+    printf("   lines       = %d (%d free)\n", num_lines, gc_free_lines());
+    printf("   mod_buf     = %d/%d\n", mod_buf_count, MOD_BUF_SIZE);
+    printf("   collections = %d\n", collections);
+    printf("   defrags     = %d\n", defrags);
+    printf("   copied      = %d\n", copied_bytes);
+    printf("   reclaimed   = %d\n", reclaimed_objects);
+
+    return NULL;
+}
+
+int gc_num_roots() {
+    return _rp;
+}
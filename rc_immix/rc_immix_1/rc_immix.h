@@ -0,0 +1,179 @@
+#ifndef GC_IMPL_RC_IMMIX_GC_H
+#define GC_IMPL_RC_IMMIX_GC_H
+
+#endif
+
+/**
+ * @brief 1字节的byte类型，用来做标识位
+ *
+ */
+typedef unsigned char byte;
+
+/**
+ * @brief 类描述
+ *
+ */
+typedef struct class_descriptor {
+    char *name;         // 类名称
+    int size;           // 类大小，即对应sizeof(struct)
+    int num_fields;     // 属性数量
+    int *field_offsets; // 类中的属性偏移，即所有属性在struct中的偏移量(字节)
+} class_descriptor;
+
+#define REF_CNT_BITS 3  // 计数器的位数，大多数对象的计数器都很小
+
+#define STICKY_RC ((1 << REF_CNT_BITS) - 1) // 计数器达到该值后不再变化，只能由积极的碎片整理回收
+
+/**
+ * @brief 基本对象类型
+ *  1. 所有对象都继承于Object
+ *  2. C中没有继承的概念，不过可以通过定义相同属性来实现，所有“继承”Object的struct，都需要将class/marked属性定义在开头
+ *  3. 新对象是上一次GC之后分配的对象，它的计数器在GC时才开始计算
+ *
+ */
+typedef struct _object object;
+struct _object {
+    class_descriptor* clss;             // 对象对应的类型
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数，GC ROOTS不计数
+    unsigned int dirty : 1;             // 是否已经记录在修改缓冲区中
+    unsigned int old : 1;               // 是否经历过GC，只有新对象会被复制
+    unsigned int forwarded : 1;         // 已拷贝标识
+    unsigned int marked : 1;            // 积极的碎片整理时的reachable标识，和mark_epoch相同时表示已标记
+    object* forwarding;                 // 目标位置
+};
+
+#define MAX_ROOTS 100
+
+#define BLOCK_SIZE (32 * 1024)  // 块大小(B)
+
+#define LINE_SIZE 256           // 线大小(B)
+
+#define LINES_PER_BLOCK (BLOCK_SIZE / LINE_SIZE)
+
+#define MAX_HEAP_SIZE 1024 * 1024 * 64 // 64MB
+
+#define MOD_BUF_SIZE 256        // 修改缓冲区最多记录的对象数，满了就执行GC
+
+#define DEFRAG_THRESHOLD 25     // 积极的碎片整理时，活动线的比例(%)不超过该值的块中的对象会被复制出去
+
+const static byte TRUE = 1;
+const static byte FALSE = 0;
+
+/**
+ * @brief GC ROOTS
+ *  1. GC ROOTS不计数，GC时把GC ROOTS引用的对象的计数器加1，下一次GC时再减回来
+ *  2. GC会复制新对象并修改GC ROOTS，分配或者修改引用之后，局部变量要从GC ROOTS中重新读取
+ *
+ */
+extern object* _roots[MAX_ROOTS];
+
+// GC ROOT 的当前下标，即记录到了第几个元素
+extern int _rp;
+
+// 堆的起始地址
+extern void* heap_start;
+
+// 堆总大小，BLOCK_SIZE的整数倍
+extern int heap_size;
+
+// 线的总数
+extern int num_lines;
+
+/**
+ * @brief 线的计数器
+ *  1. 线中活动的旧对象数，跨越多条线的对象在每条线中都计数
+ *  2. 计数器为0的线在GC之后可以重新分配
+ *
+ */
+extern byte* line_cnt;
+
+/**
+ * @brief 初始化GC
+ *
+ * @param size 堆大小，向上取整为BLOCK_SIZE的整数倍
+ */
+extern void gc_init(int size);
+
+/**
+ * @brief 执行GC(合并型引用计数)
+ *  1. 把GC ROOTS和修改缓冲区中的对象现在引用的对象的计数器加1
+ *  2. 第一次被计数的新对象变成旧对象，复制到空闲的线中(被动的碎片整理)，再计数它引用的对象
+ *  3. 把上一次GC时的GC ROOTS和修改缓冲区中记录的旧值引用的对象的计数器减1，计数器为0的对象被回收，它所在的线的计数器也减1
+ *  4. 没有被计数的新对象不需要任何处理，它们所在的线从头开始重新分配
+ *
+ */
+extern void gc();
+
+/**
+ * @brief 积极的碎片整理
+ *  1. 先执行一次GC，之后所有对象都是旧对象
+ *  2. 从GC ROOTS开始搜索，重新计算所有对象和线的计数器，回收循环引用垃圾和计数器达到STICKY_RC的垃圾
+ *  3. 活动线比例不超过DEFRAG_THRESHOLD的块中的对象被复制到其他块的空闲线中
+ *
+ */
+extern void gc_defrag();
+
+/**
+ * @brief GC结束，彻底清理堆
+ *
+ */
+extern void gc_done();
+
+/**
+ * @brief 在GC堆上分配指定类型的内存
+ *  1. 在空闲的线组成的空洞中顺序分配，空洞不够大时找下一个空洞
+ *  2. 找不到空洞时执行GC，还不够就执行积极的碎片整理
+ *
+ * @param clss 需要分配的类型
+ * @return object* 分配的对象指针
+ */
+extern object* gc_alloc(class_descriptor* clss);
+
+/**
+ * @brief 修改引用(合并型引用计数的写入屏障)
+ *  1. 旧对象在GC之后第一次被修改时，把它和它所有属性的旧值记录到修改缓冲区中，不更新计数器
+ *  2. 新对象不需要记录，它第一次被计数时会计数它所有的属性
+ *
+ * @param obj 原对象
+ * @param field_ref 原对象的属性指针
+ * @param new_obj 新对象指针
+ */
+extern void gc_update_ptr(object* obj, object** field_ref, object* new_obj);
+
+/**
+ * @brief 对象所在的线
+ *
+ * @param obj
+ * @return int
+ */
+extern int gc_line_of(void* obj);
+
+/**
+ * @brief 计数器为0的线数
+ *
+ * @return int
+ */
+extern int gc_free_lines();
+
+/**
+ * @brief DUMP GC状态
+ *
+ * @return char*
+ */
+extern char *gc_get_state();
+
+/**
+ * @brief 获取GC ROOTS数量
+ *
+ * @return int ROOTS数量
+ */
+extern int gc_num_roots();
+
+// 暂存GC ROOTS下标
+#define gc_save_rp int __rp = _rp;
+
+// 将对象添加到GC ROOTS
+#define gc_add_root(p) _roots[_rp++] = (object *)(p);
+
+// 恢复GC ROOTS下标
+#define gc_restore_roots _rp = __rp;
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * @brief 同一个工作负载分别在RC Immix、reference_counting_1和mark_sweep_3上运行
+ *  1. 编译时用BENCH_RC_IMMIX/BENCH_REFERENCE_COUNTING/BENCH_MARK_SWEEP选择收集器
+ *  2. 收集器中每个对象的printf通过-Dprintf=bench_printf去掉，结果输出到stderr
+ *
+ */
+#if defined(BENCH_RC_IMMIX)
+#include "rc_immix.h"
+#define BENCH_NAME "rc_immix"
+#elif defined(BENCH_REFERENCE_COUNTING)
+#include "reference_counting.h"
+#define BENCH_NAME "reference_counting_1"
+#elif defined(BENCH_MARK_SWEEP)
+#include "mark_sweep.h"
+#define BENCH_NAME "mark_sweep_3"
+#endif
+
+#define LISTS 16        // GC ROOTS中的链表数
+
+#define LIST_LENGTH 8   // 链表长度，超出的部分成为垃圾
+
+#define ITERATIONS 200000
+
+#define HEAP_SIZE (32 * 1024)   // 所有收集器使用同样大小的堆：RC Immix的1个块，mark_sweep_3的256个单元，不超过它的最大堆
+
+typedef struct bench_node {
+    object header;
+    int id;
+    struct bench_node* left;    // 链表中的下一个节点
+    struct bench_node* right;   // 指向链表后面的节点
+} bench_node;
+
+class_descriptor bench_node_class = {
+    "bench_node",
+    sizeof(struct bench_node),
+    2,
+    (int[]) {
+        offsetof(struct bench_node, left),
+        offsetof(struct bench_node, right)
+    }
+};
+
+// 收集器中的printf
+int bench_printf(const char* format, ...) {
+    return 0;
+}
+
+#if defined(BENCH_RC_IMMIX)
+// 写入屏障，GC ROOTS不计数
+#define bench_store(obj, field, value) gc_update_ptr((object *) (obj), (object **) &(obj)->field, (object *) (value))
+#define bench_set_root(i, value) _roots[i] = (object *) (value)
+#define bench_reserve_root() gc_add_root(NULL)
+#elif defined(BENCH_REFERENCE_COUNTING)
+// RC_EAGER时GC ROOTS也计数
+#define bench_store(obj, field, value) gc_update_ptr((object **) &(obj)->field, (value))
+#define bench_set_root(i, value) gc_update_ptr(&_roots[i], (value))
+#define bench_reserve_root() gc_add_root(NULL)
+#elif defined(BENCH_MARK_SWEEP)
+#define bench_store(obj, field, value) (obj)->field = (value)
+#define bench_set_root(i, value) _roots[i] = (object *) (value)
+#define bench_reserve_root() gc_add_root(NULL)
+#endif
+
+// 链表中的第n个节点，每次都从GC ROOTS重新读取
+bench_node* nth(int list, int n) {
+    bench_node* p = (bench_node *) _roots[list];
+    for (int i = 0; i < n && p; ++i) {
+        p = p->left;
+    }
+
+    return p;
+}
+
+int main(int argc, char* argv[]) {
+    gc_init(HEAP_SIZE);
+    for (int i = 0; i < LISTS; ++i) {
+        bench_reserve_root();
+    }
+
+    clock_t start = clock();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        int list = i % LISTS;
+
+        // 新节点放在链表头
+        bench_node* n = (bench_node *) gc_alloc(&bench_node_class);
+        n->id = i;
+        bench_store(n, left, nth(list, 0));
+        bench_set_root(list, n);
+
+        // 截断链表
+        bench_node* last = nth(list, LIST_LENGTH - 1);
+        if (last) {
+            bench_store(last, left, NULL);
+        }
+
+        // 修改链表中的引用
+        for (int j = 0; j < LIST_LENGTH; ++j) {
+            bench_node* p = nth(list, j);
+            if (p) {
+                bench_store(p, right, nth(list, j + 2));
+            }
+        }
+    }
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    // 检查链表的内容
+    for (int i = 0; i < LISTS; ++i) {
+        bench_node* p = (bench_node *) _roots[i];
+        for (int j = 0; j < LIST_LENGTH; ++j, p = p->left) {
+            int id = ITERATIONS - LISTS + i - j * LISTS;
+            if (!p || p->id != id || p->right != nth(i, j + 2)) {
+                fprintf(stderr, "%s: list %d is corrupted!\n", BENCH_NAME, i);
+                abort();
+            }
+        }
+        if (p) {
+            fprintf(stderr, "%s: list %d is too long!\n", BENCH_NAME, i);
+            abort();
+        }
+    }
+
+    fprintf(stderr, "%-22s %d iterations, %d bytes heap, %.3f sec\n", BENCH_NAME, ITERATIONS, HEAP_SIZE, seconds);
+
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "rc_immix.h"
+
+typedef struct link {
+    class_descriptor* clss;             // 对象对应的类型
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数
+    unsigned int dirty : 1;             // 是否已经记录在修改缓冲区中
+    unsigned int old : 1;               // 是否经历过GC
+    unsigned int forwarded : 1;         // 已拷贝标识
+    unsigned int marked : 1;            // reachable标识
+    object* forwarding;                 // 目标位置
+    int id;
+    struct link* next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
+// 使用中的块数
+int used_blocks() {
+    int used = 0;
+    for (int b = 0; b < num_lines / LINES_PER_BLOCK; ++b) {
+        for (int i = b * LINES_PER_BLOCK; i < (b + 1) * LINES_PER_BLOCK; ++i) {
+            if (line_cnt[i] > 0) {
+                used++;
+                break;
+            }
+        }
+    }
+
+    return used;
+}
+
+// 在GC ROOTS的第slot个位置上创建一个id从0开始的链表，每个对象之后跟着garbage个垃圾
+void make_list(int slot, int count, int garbage) {
+    _roots[slot] = NULL;
+    for (int i = count - 1; i >= 0; --i) {
+        for (int j = 0; j < garbage; ++j) {
+            gc_alloc(&link_object_class);
+        }
+
+        link* l = (link *) gc_alloc(&link_object_class);
+        l->id = i;
+        gc_update_ptr((object *) l, (object **) &l->next, _roots[slot]);
+        _roots[slot] = (object *) l;
+    }
+}
+
+// 检查链表的内容，id依次增加step
+void check_list(link* l, int count, int step) {
+    for (int i = 0; i < count; ++i, l = l->next) {
+        if (!l || l->id != i * step) {
+            printf("link list corrupted!\n");
+            abort();
+        }
+    }
+    if (l) {
+        printf("link list is too long!\n");
+        abort();
+    }
+}
+
+// 测试被动的碎片整理：存活的新对象被复制到一起，死掉的新对象不需要任何处理
+void test_reactive_defrag() {
+    printf("test_reactive_defrag\n");
+    gc_init(4 * BLOCK_SIZE);
+    gc_add_root(NULL);
+
+    make_list(0, 10, 20);
+    link* before = (link *) _roots[0];
+
+    gc();
+    link* head = (link *) _roots[0];
+    if (head == before || !head->old || !before->forwarded) {
+        printf("new object is not copied!\n");
+        abort();
+    }
+    check_list(head, 10, 1);
+    for (link* l = head->next; l; l = l->next) {
+        if (l->ref_cnt != 1 || !l->old) {
+            printf("reference count of promoted object is %d!\n", l->ref_cnt);
+            abort();
+        }
+    }
+
+    // 10个对象复制到连续的线中，其他的线都空闲
+    int used_lines = num_lines - gc_free_lines();
+    if (used_lines > (10 * sizeof(link) + LINE_SIZE - 1) / LINE_SIZE + 1) {
+        printf("%d lines are used!\n", used_lines);
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试线的计数器：线中的对象都死掉之后回收整条线
+void test_line_reclaim() {
+    printf("test_line_reclaim\n");
+    gc_init(4 * BLOCK_SIZE);
+    gc_add_root(NULL);
+
+    make_list(0, 1000, 0);
+    gc();
+    check_list((link *) _roots[0], 1000, 1);
+    if (gc_free_lines() == num_lines) {
+        printf("lines of live objects are free!\n");
+        abort();
+    }
+
+    // GC ROOTS的计数在下一次GC时才减掉
+    _roots[0] = NULL;
+    gc();
+    if (gc_free_lines() != num_lines) {
+        printf("%d lines are not reclaimed!\n", num_lines - gc_free_lines());
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试合并型引用计数：GC之间多次修改同一个旧对象只记录一次
+void test_coalesced_rc() {
+    printf("test_coalesced_rc\n");
+    gc_init(4 * BLOCK_SIZE);
+
+    for (int i = 0; i < 3; ++i) {
+        gc_add_root(gc_alloc(&link_object_class));
+    }
+    gc();
+
+    link* x = (link *) _roots[0];
+    link* a = (link *) _roots[1];
+    link* b = (link *) _roots[2];
+    for (int i = 0; i < 1001; ++i) {
+        gc_update_ptr((object *) x, (object **) &x->next, (object *) (i % 2 ? b : a));
+    }
+    if (!x->dirty || a->ref_cnt != 1 || b->ref_cnt != 1) {
+        printf("reference count is updated on store!\n");
+        abort();
+    }
+
+    gc();
+    if (x->dirty || a->ref_cnt != 2 || b->ref_cnt != 1) {
+        printf("coalesced count is wrong: a = %d, b = %d\n", a->ref_cnt, b->ref_cnt);
+        abort();
+    }
+
+    // 修改缓冲区满了之后，在修改之前执行GC
+    make_list(1, 2 * MOD_BUF_SIZE, 0);
+    gc();
+    for (link* l = (link *) _roots[1]; l; l = l->next) {
+        gc_update_ptr((object *) l, (object **) &l->next, (object *) l->next);
+    }
+    check_list((link *) _roots[1], 2 * MOD_BUF_SIZE, 1);
+
+    gc_get_state();
+    gc_done();
+}
+
+// 测试积极的碎片整理：回收循环引用垃圾和计数器达到STICKY_RC的垃圾，压缩稀疏的块
+void test_proactive_defrag() {
+    printf("test_proactive_defrag\n");
+    gc_init(8 * BLOCK_SIZE);
+    gc_add_root(NULL);
+
+    // 循环引用垃圾
+    make_list(0, 10, 0);
+    link* tail = (link *) _roots[0];
+    while (tail->next) {
+        tail = tail->next;
+    }
+    gc_update_ptr((object *) tail, (object **) &tail->next, _roots[0]);
+    gc();
+
+    // 计数器达到STICKY_RC的垃圾，引用它的对象都放在GC ROOTS中
+    _roots[0] = gc_alloc(&link_object_class);
+    for (int i = 0; i < STICKY_RC + 2; ++i) {
+        link* l = (link *) gc_alloc(&link_object_class);
+        gc_update_ptr((object *) l, (object **) &l->next, _roots[0]);
+        gc_add_root(l);
+    }
+    gc();
+    link* sticky = ((link *) _roots[1])->next;
+    if (sticky->ref_cnt != STICKY_RC) {
+        printf("reference count is not sticky!\n");
+        abort();
+    }
+
+    _rp = 1;
+    _roots[0] = NULL;
+    gc();
+    gc();
+    if (gc_free_lines() == num_lines) {
+        printf("cyclic or sticky garbage is reclaimed by reference counting!\n");
+        abort();
+    }
+
+    gc_defrag();
+    if (gc_free_lines() != num_lines) {
+        printf("%d lines are not reclaimed by defrag!\n", num_lines - gc_free_lines());
+        abort();
+    }
+
+    // 每100个对象留下一个，所有的块都很稀疏
+    make_list(0, 3000, 0);
+    gc();
+    for (link* l = (link *) _roots[0]; l; l = l->next) {
+        link* next = l;
+        for (int i = 0; i < 100 && next; ++i) {
+            next = next->next;
+        }
+        gc_update_ptr((object *) l, (object **) &l->next, (object *) next);
+    }
+    gc();
+    check_list((link *) _roots[0], 30, 100);
+
+    int before = used_blocks();
+    gc_defrag();
+    check_list((link *) _roots[0], 30, 100);
+    if (used_blocks() != 1 || before <= 1) {
+        printf("sparse blocks are not compacted: %d -> %d\n", before, used_blocks());
+        abort();
+    }
+
+    gc_get_state();
+    gc_done();
+}
+
+int main(int argc, char* argv[]) {
+
+    test_reactive_defrag();
+    test_line_reclaim();
+    test_coalesced_rc();
+    test_proactive_defrag();
+
+    return 0;
+}
@@ -1,15 +1,68 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 #include "reference_counting.h"
 
 node *next_free;
 node *head;
-int _rp;
+void *heap_start;
+void *heap_end;
+__thread object* _roots[MAX_ROOTS];
+__thread int _rp;
+
+pthread_mutex_t heap_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;    // RC_BIASED时保护free-list
+
+rc_mode gc_rc_mode = RC_EAGER;  // 引用计数的方式
+
+object** zct;           // Zero Count Table，计数器为0、可能已经是垃圾的对象
+int zct_count;
+int zct_capacity;
+int zct_limit;          // ZCT中的对象数达到该值时，在下次分配时回收
+
+__thread object** free_queue;    // 计数器变为0、还没有回收的对象，每个线程一个
+__thread int free_queue_count;
+__thread int free_queue_capacity;
+int free_budget = FREE_BUDGET;  // 每次操作最多回收的对象数，0表示不限制
 
 /**
- * @brief 回收对象
+ * @brief 修改缓冲区
+ *  1. 每一项是一个对象，后面跟着它第一次被修改之前所有属性的值
+ *  2. 对象的dirty为TRUE时表示已经记录过，这个周期内再修改它的属性不需要做任何事
+ * 
+ */
+object** mod_buf;
+int mod_buf_top;        // 修改缓冲区中已经使用的大小
+int mod_buf_capacity;
+int mod_buf_count;      // 修改缓冲区中记录的对象数
+
+/**
+ * @brief 候选对象缓冲区
+ *  1. 计数器减1之后没有变为0的对象，可能是循环引用垃圾中的一个对象
+ *  2. 积攒到candidate_limit个再一起回收，多个候选对象能到达的对象只搜索一次
+ * 
+ */
+object** candidates;
+int candidate_count;
+int candidate_capacity;
+int candidate_limit;    // 候选对象数达到该值时，在下次分配时回收循环引用垃圾
+
+int sticky_count;       // 计数器达到STICKY_RC的对象数
+
+__thread int gc_tid = -1;   // 当前线程的编号
+int gc_threads;             // 已经分配的线程编号数
+merge_queue merge_queues[MAX_THREADS];
+brc_counter* brc_counters;  // RC_BIASED时每个单元的附加计数器
+
+object** cycle_stack;   // 回收循环引用时搜索对象用的栈
+int cycle_sp;
+int cycle_stack_capacity;
+
+/**
+ * @brief 回收对象，把对象所在的单元放回空闲链表的最前面
+ *  1. 定义了DO_DEBUG时清空对象，方便发现使用已回收对象的错误
  * 
  * @param obj 
  */
@@ -29,18 +82,211 @@ void inc_ref_cnt(object *obj);
  */
 void dec_ref_cnt(object *obj);
 
+/**
+ * @brief 把计数器变为0的对象放入当前线程的待回收队列
+ * 
+ * @param obj 
+ */
+void free_queue_add(object* obj);
+
+/**
+ * @brief 从待回收队列中回收对象
+ *  1. 回收对象时减少它引用的对象的计数器，变为0的对象同样放入队列，不需要递归
+ * 
+ * @param budget 最多回收的对象数，0表示回收完
+ */
+void drain_free_queue(int budget);
+
+/**
+ * @brief 把计数器为0的对象放入ZCT
+ * 
+ * @param obj 
+ */
+void zct_add(object* obj);
+
+/**
+ * @brief 回收ZCT中的垃圾
+ *  1. 先把GC ROOTS引用的对象的计数器加1，这时计数器还是0的对象一定是垃圾
+ *  2. 回收垃圾时减少它引用的对象的计数器，变为0的对象放入ZCT，在同一次回收中处理
+ *  3. 最后把GC ROOTS引用的对象的计数器减回来，变为0的对象留在ZCT中
+ *  4. 留在ZCT中的对象太多时扩大ZCT，避免每次分配都回收
+ * 
+ */
+void zct_collect();
+
+/**
+ * @brief 找到属性所属的对象
+ * 
+ * @param ptr 属性指针
+ * @return object* 不是堆中对象的属性时返回NULL
+ */
+object* owner_of(object** ptr);
+
+/**
+ * @brief 把对象和它所有属性的当前值记录到修改缓冲区中
+ * 
+ * @param obj 
+ */
+void mod_buf_register(object* obj);
+
+/**
+ * @brief 合并修改缓冲区中的计数
+ *  1. 对象现在引用的对象计数器加1，记录下来的旧值引用的对象计数器减1
+ *  2. 一个周期内对同一个对象的多次修改，只剩下第一次修改之前和最后一次修改之后的差别
+ *  3. 先加后减，和gc_update_ptr的理由一样
+ * 
+ */
+void mod_buf_flush();
+
+/**
+ * @brief 临时把GC ROOTS引用的对象的计数器加1
+ * 
+ */
+void count_roots();
+
+/**
+ * @brief 把GC ROOTS引用的对象的计数器减回来，变为0的对象放入ZCT
+ * 
+ */
+void uncount_roots();
+
+/**
+ * @brief 回收计数器为0的对象，并减少它引用的对象的计数器
+ *  1. 对象还在候选对象缓冲区中时也直接回收，缓冲区中留下的过期项在回收循环引用时跳过
+ * 
+ * @param obj 
+ */
+void release(object* obj);
+
+/**
+ * @brief 把可能是循环引用垃圾的对象放入候选对象缓冲区
+ * 
+ * @param obj 
+ */
+void possible_root(object* obj);
+
+/**
+ * @brief 回收循环引用垃圾(部分标记-清除)
+ *  1. 先回收待回收队列或者ZCT中的垃圾，这之后计数器为0的对象都是活动对象或者已经被回收了
+ *  2. 延迟引用计数时临时把GC ROOTS计数
+ *  3. mark_roots: 从候选对象开始涂灰，试减它们引用的对象的计数器
+ *  4. scan_roots: 计数器还大于0的灰色对象被外部引用，涂黑并恢复计数器，剩下的涂白
+ *  5. collect_roots: 回收白色对象
+ *  6. 回收到的垃圾少于候选对象的一半时扩大缓冲区，避免在很大的活动对象上反复搜索
+ * 
+ */
+void collect_cycles();
+
+/**
+ * @brief 当前线程的编号，第一次调用时分配
+ * 
+ * @return int 
+ */
+int current_tid();
+
+/**
+ * @brief 对象所在单元的偏向引用计数计数器
+ * 
+ * @param obj 
+ * @return brc_counter* 
+ */
+brc_counter* brc_of(object* obj);
+
+void lock_heap();
+
+void unlock_heap();
+
+/**
+ * @brief RC_BIASED时增加计数
+ *  1. 所有者线程在合并之前修改ref_cnt，ref_cnt放不下时加到shared_cnt上
+ *  2. 其他线程原子地修改shared_cnt
+ * 
+ * @param obj 
+ */
+void biased_inc(object* obj);
+
+/**
+ * @brief RC_BIASED时减少计数
+ *  1. 所有者线程的计数器变为0时合并，shared_cnt也为0就回收
+ *  2. 其他线程第一次把shared_cnt减为负数时，放入所有者线程的合并队列
+ *  3. 合并之后shared_cnt变为0的线程回收对象，在合并队列中的对象由所有者线程回收
+ * 
+ * @param obj 
+ */
+void biased_dec(object* obj);
+
+/**
+ * @brief 把对象放入所有者线程的合并队列
+ * 
+ * @param obj 
+ */
+void merge_queue_add(object* obj);
+
+/**
+ * @brief 合并线程的合并队列中的对象，计数器为0的对象放入当前线程的待回收队列
+ * 
+ * @param tid 线程编号，只能是当前线程，或者已经结束的线程
+ */
+void merge_queue_process(int tid);
+
+/**
+ * @brief 备份的标记-清除
+ *  1. 从GC ROOTS开始标记活动对象，回收没有标记的对象，包括计数器达到STICKY_RC的垃圾和循环引用垃圾
+ *  2. 根据活动对象之间的引用重新计算计数器，RC_EAGER时GC ROOTS也计数
+ *  3. 待回收队列、ZCT、修改缓冲区、候选对象缓冲区中的内容都不再需要，直接丢弃
+ * 
+ */
+void mark_sweep();
+
+/**
+ * @brief 从obj开始涂灰，试减灰色对象引用的对象的计数器
+ * 
+ * @param obj 
+ */
+void mark_gray(object* obj);
+
+/**
+ * @brief 计数器大于0的灰色对象涂黑，否则涂白
+ * 
+ * @param obj 
+ */
+void scan(object* obj);
+
+/**
+ * @brief 从obj开始涂黑，恢复黑色对象引用的对象的计数器
+ * 
+ * @param obj 
+ */
+void scan_black(object* obj);
+
+/**
+ * @brief 从obj开始回收白色对象
+ *  1. 还在候选对象缓冲区中的白色对象，留给它自己回收
+ * 
+ * @param obj 
+ * @return int 回收的对象数
+ */
+int collect_white(object* obj);
+
 int resolve_heap_size(int size);
 
 /**
- * @brief 查找空闲内存单元
+ * @brief 空闲链表为空时回收垃圾，得到空闲单元
  * 
  * @return node* 
  */
 node *find_idle_node();
 
 void reclaim(object* obj) {
+#ifdef DO_DEBUG
     // 回收对象所属的node
     memset(obj, 0, obj->clss->size);
+#endif
+
+    // 候选对象缓冲区中留下的过期项靠它跳过
+    obj->buffered = FALSE;
+
+    lock_heap();
 
     // 通过地址计算出，对象所在的node
     node* _node = (node*) ((void *) obj - sizeof(node));
@@ -48,8 +294,10 @@ void reclaim(object* obj) {
     _node->data = NULL;
     _node->size = 0;
 
-    // 将next_free更新为当前回收的node
+    // 放到空闲链表的最前面
+    _node->free_next = next_free;
     next_free = _node;
+    unlock_heap();
     printf("collection ...\n");
 }
 
@@ -58,7 +306,19 @@ void inc_ref_cnt(object* obj) {
         return;
     }
 
-    obj->ref_cnt++;
+    if (gc_rc_mode == RC_BIASED) {
+        biased_inc(obj);
+        return;
+    }
+
+    // Sticky的计数器不再变化
+    if (obj->ref_cnt == STICKY_RC) {
+        return;
+    }
+
+    if (++obj->ref_cnt == STICKY_RC) {
+        sticky_count++;
+    }
 }
 
 void dec_ref_cnt(object* obj) {
@@ -66,15 +326,548 @@ void dec_ref_cnt(object* obj) {
         return;
     }
 
+    if (gc_rc_mode == RC_BIASED) {
+        biased_dec(obj);
+        return;
+    }
+
+    if (obj->ref_cnt == STICKY_RC) {
+        return;
+    }
+
     obj->ref_cnt--;
-    // 如果计数器为0，则对象需要被回收，那么该对象引用的对象计数器都需要减少
-    if (obj->ref_cnt == 0) {
+
+    // 延迟引用计数时GC ROOTS可能还引用着它，合并引用计数时修改缓冲区中可能还有没有合并的计数
+    if (obj->ref_cnt == 0 && gc_rc_mode != RC_EAGER) {
+        zct_add(obj);
+        return;
+    }
+
+    // 计数器没有变为0的对象可能是循环引用垃圾
+    if (obj->ref_cnt > 0) {
+        possible_root(obj);
+        return;
+    }
+
+    // 如果计数器为0，则对象需要被回收，放入待回收队列，由drain_free_queue减少它引用的对象的计数器
+    free_queue_add(obj);
+}
+
+void free_queue_add(object* obj) {
+    if (free_queue_count == free_queue_capacity) {
+        free_queue_capacity = free_queue_capacity ? free_queue_capacity * 2 : 64;
+        free_queue = (object **) realloc(free_queue, free_queue_capacity * sizeof(object *));
+    }
+    free_queue[free_queue_count++] = obj;
+}
+
+int current_tid() {
+    if (gc_tid < 0) {
+        gc_tid = __atomic_fetch_add(&gc_threads, 1, __ATOMIC_SEQ_CST);
+        if (gc_tid >= MAX_THREADS) {
+            printf("Too many threads!\n");
+            abort();
+        }
+    }
+
+    return gc_tid;
+}
+
+brc_counter* brc_of(object* obj) {
+    return &brc_counters[((void *) obj - heap_start) / NODE_SIZE];
+}
+
+void lock_heap() {
+    if (gc_rc_mode == RC_BIASED) {
+        pthread_mutex_lock(&heap_lock);
+    }
+}
+
+void unlock_heap() {
+    if (gc_rc_mode == RC_BIASED) {
+        pthread_mutex_unlock(&heap_lock);
+    }
+}
+
+void biased_inc(object* obj) {
+    brc_counter* brc = brc_of(obj);
+
+    // 只有所有者线程会设置BRC_MERGED，所有者线程读到的一定是最新的
+    if (brc->owner == current_tid() && obj->ref_cnt < STICKY_RC
+            && !(__atomic_load_n(&brc->shared_cnt, __ATOMIC_RELAXED) & BRC_MERGED)) {
+        obj->ref_cnt++;
+        return;
+    }
+
+    __atomic_add_fetch(&brc->shared_cnt, BRC_ONE, __ATOMIC_RELAXED);
+}
+
+void biased_dec(object* obj) {
+    brc_counter* brc = brc_of(obj);
+    int shared = __atomic_load_n(&brc->shared_cnt, __ATOMIC_ACQUIRE);
+
+    if (brc->owner == current_tid() && !(shared & BRC_MERGED)) {
+        if (obj->ref_cnt > 0) {
+            obj->ref_cnt--;
+            if (obj->ref_cnt > 0) {
+                return;
+            }
+        } else {
+            // ref_cnt放不下时加到了shared_cnt上
+            __atomic_sub_fetch(&brc->shared_cnt, BRC_ONE, __ATOMIC_ACQ_REL);
+        }
+
+        // 所有者线程的计数器变为0，合并
+        shared = __atomic_or_fetch(&brc->shared_cnt, BRC_MERGED, __ATOMIC_ACQ_REL);
+        if (BRC_COUNT(shared) == 0 && !(shared & BRC_QUEUED)) {
+            free_queue_add(obj);
+        }
+        return;
+    }
+
+    int new_shared;
+    do {
+        new_shared = shared - BRC_ONE;
+        if (BRC_COUNT(new_shared) < 0 && !(new_shared & (BRC_MERGED | BRC_QUEUED))) {
+            new_shared |= BRC_QUEUED;
+        }
+    } while (!__atomic_compare_exchange_n(&brc->shared_cnt, &shared, new_shared, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    if ((new_shared & BRC_QUEUED) && !(shared & BRC_QUEUED)) {
+        merge_queue_add(obj);
+    } else if ((new_shared & BRC_MERGED) && !(new_shared & BRC_QUEUED) && BRC_COUNT(new_shared) == 0) {
+        free_queue_add(obj);
+    }
+}
+
+void merge_queue_add(object* obj) {
+    merge_queue* q = &merge_queues[brc_of(obj)->owner];
+    while (__atomic_test_and_set(&q->lock, __ATOMIC_ACQUIRE)) {}
+
+    if (q->count == q->capacity) {
+        q->capacity = q->capacity ? q->capacity * 2 : 64;
+        q->objs = (object **) realloc(q->objs, q->capacity * sizeof(object *));
+    }
+    q->objs[q->count++] = obj;
+
+    __atomic_clear(&q->lock, __ATOMIC_RELEASE);
+}
+
+void merge_queue_process(int tid) {
+    merge_queue* q = &merge_queues[tid];
+
+    // 每次只在锁中取出一个对象，回收对象时可能又放入这个队列
+    while (__atomic_load_n(&q->count, __ATOMIC_RELAXED) > 0) {
+        while (__atomic_test_and_set(&q->lock, __ATOMIC_ACQUIRE)) {}
+        object* obj = q->count > 0 ? q->objs[--q->count] : NULL;
+        __atomic_clear(&q->lock, __ATOMIC_RELEASE);
+
+        if (!obj) {
+            break;
+        }
+
+        brc_counter* brc = brc_of(obj);
+        int biased = obj->ref_cnt;
+        obj->ref_cnt = 0;
+
+        int shared = __atomic_load_n(&brc->shared_cnt, __ATOMIC_ACQUIRE);
+        int new_shared;
+        do {
+            new_shared = ((shared + biased * BRC_ONE) | BRC_MERGED) & ~BRC_QUEUED;
+        } while (!__atomic_compare_exchange_n(&brc->shared_cnt, &shared, new_shared, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+        if (BRC_COUNT(new_shared) == 0) {
+            free_queue_add(obj);
+        }
+    }
+}
+
+void drain_free_queue(int budget) {
+    for (int n = 0; free_queue_count > 0 && (budget <= 0 || n < budget); ++n) {
+        release(free_queue[--free_queue_count]);
+    }
+}
+
+void release(object* obj) {
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        dec_ref_cnt(*((object **) ((void *) obj + obj->clss->field_offsets[i])));
+    }
+
+    // 回收
+    reclaim(obj);
+}
+
+void possible_root(object* obj) {
+    if (obj->color == HATCH) {
+        return;
+    }
+    obj->color = HATCH;
+
+    if (obj->buffered) {
+        return;
+    }
+
+    if (candidate_count == candidate_capacity) {
+        candidate_capacity = candidate_capacity ? candidate_capacity * 2 : CANDIDATE_SIZE;
+        candidates = (object **) realloc(candidates, candidate_capacity * sizeof(object *));
+    }
+    candidates[candidate_count++] = obj;
+    obj->buffered = TRUE;
+}
+
+void zct_add(object* obj) {
+    if (obj->in_zct) {
+        return;
+    }
+
+    if (zct_count == zct_capacity) {
+        zct_capacity = zct_capacity ? zct_capacity * 2 : ZCT_SIZE;
+        zct = (object **) realloc(zct, zct_capacity * sizeof(object *));
+    }
+    zct[zct_count++] = obj;
+    obj->in_zct = TRUE;
+}
+
+void zct_collect() {
+    // 合并引用计数时先合并计数，这之后计数器还是0的对象才能判断是不是垃圾
+    mod_buf_flush();
+
+    printf("scan zct ...\n");
+
+    count_roots();
+
+    while (zct_count > 0) {
+        object* obj = zct[--zct_count];
+        obj->in_zct = FALSE;
+
+        // 计数器不为0的对象又被引用了，只是从ZCT中移除
+        if (obj->ref_cnt > 0) {
+            continue;
+        }
+
+        release(obj);
+    }
+
+    uncount_roots();
+
+    if (zct_count * 2 > zct_limit) {
+        zct_limit *= 2;
+    }
+}
+
+void count_roots() {
+    for (int i = 0; i < _rp; ++i) {
+        inc_ref_cnt(_roots[i]);
+    }
+}
+
+void uncount_roots() {
+    // 不是真的删除引用，不需要放入候选对象缓冲区
+    for (int i = 0; i < _rp; ++i) {
+        if (_roots[i] && _roots[i]->ref_cnt != STICKY_RC && --_roots[i]->ref_cnt == 0) {
+            zct_add(_roots[i]);
+        }
+    }
+}
+
+// 压入回收循环引用时的栈
+void cycle_push(object* obj) {
+    if (cycle_sp == cycle_stack_capacity) {
+        cycle_stack_capacity = cycle_stack_capacity ? cycle_stack_capacity * 2 : CANDIDATE_SIZE;
+        cycle_stack = (object **) realloc(cycle_stack, cycle_stack_capacity * sizeof(object *));
+    }
+    cycle_stack[cycle_sp++] = obj;
+}
+
+void mark_gray(object* obj) {
+    if (obj->color == GRAY) {
+        return;
+    }
+    obj->color = GRAY;
+    cycle_push(obj);
+
+    // 用栈代替递归，很长的链表也不会栈溢出
+    while (cycle_sp > 0) {
+        object* o = cycle_stack[--cycle_sp];
+        for (int i = 0; i < o->clss->num_fields; ++i) {
+            object* child = *((object **) ((void *) o + o->clss->field_offsets[i]));
+            if (!child) {
+                continue;
+            }
+
+            // 试减，不是循环引用垃圾时在scan_black中恢复，Sticky的对象一直不会减到0
+            if (child->ref_cnt != STICKY_RC) {
+                child->ref_cnt--;
+            }
+            if (child->color != GRAY) {
+                child->color = GRAY;
+                cycle_push(child);
+            }
+        }
+    }
+}
+
+void scan(object* obj) {
+    cycle_push(obj);
+
+    while (cycle_sp > 0) {
+        object* o = cycle_stack[--cycle_sp];
+        if (o->color != GRAY) {
+            continue;
+        }
+
+        // 还被灰色对象以外的对象引用，不是垃圾
+        if (o->ref_cnt > 0) {
+            scan_black(o);
+            continue;
+        }
+
+        o->color = WHITE;
+        for (int i = 0; i < o->clss->num_fields; ++i) {
+            object* child = *((object **) ((void *) o + o->clss->field_offsets[i]));
+            if (child) {
+                cycle_push(child);
+            }
+        }
+    }
+}
+
+void scan_black(object* obj) {
+    // 在栈中已有的内容之上搜索，结束时栈回到原来的高度
+    int sp = cycle_sp;
+    obj->color = BLACK;
+    cycle_push(obj);
+
+    while (cycle_sp > sp) {
+        object* o = cycle_stack[--cycle_sp];
+        for (int i = 0; i < o->clss->num_fields; ++i) {
+            object* child = *((object **) ((void *) o + o->clss->field_offsets[i]));
+            if (!child) {
+                continue;
+            }
+
+            if (child->ref_cnt != STICKY_RC) {
+                child->ref_cnt++;
+            }
+            if (child->color != BLACK) {
+                child->color = BLACK;
+                cycle_push(child);
+            }
+        }
+    }
+}
+
+int collect_white(object* obj) {
+    if (obj->color != WHITE || obj->buffered) {
+        return 0;
+    }
+    obj->color = BLACK;
+    cycle_push(obj);
+
+    int n = 0;
+    while (cycle_sp > 0) {
+        object* o = cycle_stack[--cycle_sp];
+        for (int i = 0; i < o->clss->num_fields; ++i) {
+            object* child = *((object **) ((void *) o + o->clss->field_offsets[i]));
+            if (child && child->color == WHITE && !child->buffered) {
+                // 涂黑防止重复回收，并非真的不是垃圾
+                child->color = BLACK;
+                cycle_push(child);
+            }
+        }
+        reclaim(o);
+        n++;
+    }
+
+    return n;
+}
+
+void collect_cycles() {
+    if (gc_rc_mode == RC_EAGER) {
+        drain_free_queue(0);
+    } else {
+        zct_collect();
+        count_roots();
+    }
+
+    printf("scan cycles ...\n");
+    int examined = candidate_count;
+
+    // mark_roots
+    int n = 0;
+    for (int i = 0; i < candidate_count; ++i) {
+        object* obj = candidates[i];
+        // 对象已经被回收了，单元可能又分配给了别的对象，这时buffered为FALSE
+        if (!obj->buffered) {
+            continue;
+        }
+
+        if (obj->color == HATCH && obj->ref_cnt > 0) {
+            mark_gray(obj);
+            candidates[n++] = obj;
+        } else {
+            obj->buffered = FALSE;
+        }
+    }
+    candidate_count = n;
+
+    // scan_roots
+    for (int i = 0; i < candidate_count; ++i) {
+        scan(candidates[i]);
+    }
+
+    // collect_roots
+    int reclaimed = 0;
+    for (int i = 0; i < candidate_count; ++i) {
+        candidates[i]->buffered = FALSE;
+        reclaimed += collect_white(candidates[i]);
+    }
+    candidate_count = 0;
+
+    if (gc_rc_mode != RC_EAGER) {
+        uncount_roots();
+    }
+
+    if (reclaimed * 2 < examined) {
+        candidate_limit *= 2;
+    }
+}
+
+void mark_sweep() {
+    printf("mark sweep ...\n");
+
+    free_queue_count = 0;
+    zct_count = 0;
+    mod_buf_top = 0;
+    mod_buf_count = 0;
+    candidate_count = 0;
+
+    // 标记
+    for (int i = 0; i < _rp; ++i) {
+        if (_roots[i] && !_roots[i]->marked) {
+            _roots[i]->marked = TRUE;
+            cycle_push(_roots[i]);
+        }
+    }
+
+    while (cycle_sp > 0) {
+        object* o = cycle_stack[--cycle_sp];
+        for (int i = 0; i < o->clss->num_fields; ++i) {
+            object* child = *((object **) ((void *) o + o->clss->field_offsets[i]));
+            if (child && !child->marked) {
+                child->marked = TRUE;
+                cycle_push(child);
+            }
+        }
+    }
+
+    // 重新计算计数器
+    for (node* _node = head; _node; _node = _node->next) {
+        object* obj = _node->data;
+        if (_node->used && obj->marked) {
+            obj->ref_cnt = 0;
+            obj->in_zct = FALSE;
+            obj->dirty = FALSE;
+            obj->color = BLACK;
+            obj->buffered = FALSE;
+        }
+    }
+
+    sticky_count = 0;
+    for (node* _node = head; _node; _node = _node->next) {
+        object* obj = _node->data;
+        if (!_node->used || !obj->marked) {
+            continue;
+        }
+
         for (int i = 0; i < obj->clss->num_fields; ++i) {
-            dec_ref_cnt(*((object **) ((void *) obj + obj->clss->field_offsets[i])));
+            inc_ref_cnt(*((object **) ((void *) obj + obj->clss->field_offsets[i])));
         }
-        // 回收
-        reclaim(obj);
     }
+
+    if (gc_rc_mode == RC_EAGER) {
+        count_roots();
+    }
+
+    // 清除
+    for (node* _node = head; _node; _node = _node->next) {
+        object* obj = _node->data;
+        if (!_node->used) {
+            continue;
+        }
+
+        if (!obj->marked) {
+            reclaim(obj);
+            continue;
+        }
+
+        obj->marked = FALSE;
+        // 只被GC ROOTS引用的对象
+        if (obj->ref_cnt == 0) {
+            zct_add(obj);
+        }
+    }
+}
+
+object* owner_of(object** ptr) {
+    if ((void *) ptr < heap_start || (void *) ptr >= heap_end) {
+        return NULL;
+    }
+
+    // 单元大小固定，通过地址计算出属性所在的node
+    node* _node = (node *) (heap_start + ((void *) ptr - heap_start) / NODE_SIZE * NODE_SIZE);
+    if (!_node->used || (void *) ptr < (void *) _node->data) {
+        return NULL;
+    }
+
+    return _node->data;
+}
+
+void mod_buf_register(object* obj) {
+    int need = 1 + obj->clss->num_fields;
+    if (mod_buf_top + need > mod_buf_capacity) {
+        mod_buf_capacity = mod_buf_capacity ? mod_buf_capacity * 2 : MOD_BUF_SIZE * 4;
+        if (mod_buf_capacity < mod_buf_top + need) {
+            mod_buf_capacity = mod_buf_top + need;
+        }
+        mod_buf = (object **) realloc(mod_buf, mod_buf_capacity * sizeof(object *));
+    }
+
+    mod_buf[mod_buf_top++] = obj;
+    for (int i = 0; i < obj->clss->num_fields; ++i) {
+        mod_buf[mod_buf_top++] = *((object **) ((void *) obj + obj->clss->field_offsets[i]));
+    }
+    mod_buf_count++;
+    obj->dirty = TRUE;
+}
+
+void mod_buf_flush() {
+    for (int top = 0; top < mod_buf_top; ) {
+        object* obj = mod_buf[top];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            inc_ref_cnt(*((object **) ((void *) obj + obj->clss->field_offsets[i])));
+        }
+        top += 1 + obj->clss->num_fields;
+    }
+
+    for (int top = 0; top < mod_buf_top; ) {
+        object* obj = mod_buf[top++];
+        for (int i = 0; i < obj->clss->num_fields; ++i) {
+            dec_ref_cnt(mod_buf[top++]);
+        }
+        obj->dirty = FALSE;
+    }
+
+    mod_buf_top = 0;
+    mod_buf_count = 0;
+}
+
+void gc_set_rc_mode(rc_mode mode) {
+    gc_rc_mode = mode;
+}
+
+void gc_set_free_budget(int n) {
+    free_budget = n < 0 ? 0 : n;
 }
 
 /**
@@ -86,17 +879,55 @@ void dec_ref_cnt(object* obj) {
  * @param obj 
  */
 void gc_update_ptr(object** ptr, void* obj) {
+    object* owner = gc_rc_mode == RC_COALESCED ? owner_of(ptr) : NULL;
+    if (owner) {
+        if (!owner->dirty) {
+            // 修改缓冲区满了就先回收，这时还没有修改，计数器和堆是一致的
+            if (mod_buf_count >= MOD_BUF_SIZE) {
+                zct_collect();
+            }
+            mod_buf_register(owner);
+        }
+        *ptr = obj;
+        return;
+    }
+
     inc_ref_cnt(obj);
     dec_ref_cnt(*ptr);
     *ptr = obj;
+
+    drain_free_queue(free_budget);
 }
 
 void gc_add_root(void* obj) {
-    inc_ref_cnt((object *) obj);
+    if (_rp == MAX_ROOTS) {
+        printf("Too many roots!\n");
+        abort();
+    }
+    _roots[_rp++] = (object *) obj;
+
+    if (gc_rc_mode == RC_EAGER || gc_rc_mode == RC_BIASED) {
+        inc_ref_cnt((object *) obj);
+    }
 }
 
 void gc_remove_root(void* obj) {
-    dec_ref_cnt((object *) obj);
+    // 从后往前找，和局部变量出栈的顺序一致
+    for (int i = _rp - 1; i >= 0; --i) {
+        if (_roots[i] == obj) {
+            _roots[i] = _roots[--_rp];
+            break;
+        }
+    }
+
+    if (gc_rc_mode == RC_EAGER || gc_rc_mode == RC_BIASED) {
+        dec_ref_cnt((object *) obj);
+        drain_free_queue(free_budget);
+    } else if (obj && (gc_rc_mode == RC_COALESCED || ((object *) obj)->ref_cnt > 0)) {
+        // GC ROOTS不计数，对象还被堆中的对象引用时，可能是循环引用垃圾
+        // 合并引用计数时修改缓冲区中还有没有合并的计数，计数器为0也可能被堆中的对象引用
+        possible_root((object *) obj);
+    }
 }
 
 int resolve_heap_size(int size) {
@@ -114,12 +945,17 @@ int resolve_heap_size(int size) {
 node* init_free_list(int free_list_size) {
     node *head = NULL;
 
+    // 所有单元分配在一块连续的内存中
+    heap_start = malloc(free_list_size * NODE_SIZE);
+    heap_end = heap_start + free_list_size * NODE_SIZE;
+
     for (int i = 0; i < free_list_size; ++i) {
-        node *_node = (node *) malloc(NODE_SIZE);
+        node *_node = (node *) (heap_start + i * NODE_SIZE);
         _node->next = head;
         _node->size = NODE_SIZE;
         _node->used = FALSE;
         _node->data = NULL;
+        _node->free_next = head;
         head = _node;
     }
 
@@ -131,22 +967,93 @@ void gc_init(int size) {
     int free_list_size = heap_size / NODE_SIZE;
     head = init_free_list(free_list_size);
 
+    free(brc_counters);
+    brc_counters = gc_rc_mode == RC_BIASED ? (brc_counter *) calloc(free_list_size, sizeof(brc_counter)) : NULL;
+
     next_free = head;
+    free_queue_count = 0;
+
+    _rp = 0;
+    zct_count = 0;
+    zct_limit = ZCT_SIZE;
+
+    mod_buf_top = 0;
+    mod_buf_count = 0;
+
+    candidate_count = 0;
+    candidate_limit = CANDIDATE_SIZE;
+
+    sticky_count = 0;
+}
+
+void gc() {
+    if (gc_rc_mode == RC_BIASED) {
+        for (int tid = 0; tid < gc_threads; ++tid) {
+            merge_queue_process(tid);
+        }
+        drain_free_queue(0);
+    } else if (sticky_count > 0) {
+        mark_sweep();
+    } else {
+        collect_cycles();
+    }
+}
+
+void gc_thread_done() {
+    merge_queue_process(current_tid());
+    drain_free_queue(0);
 }
 
 node *find_idle_node() {
-    for (next_free = head; next_free && next_free->used; next_free = next_free->next) {}
+    // 空闲链表为空就从待回收队列中回收一个对象，回收的单元会成为next_free
+    if (!next_free && free_queue_count > 0) {
+        drain_free_queue(1);
+    }
+
+    // 延迟引用计数时回收ZCT中的垃圾，合并引用计数时修改缓冲区中的计数也可能产生垃圾
+    if (!next_free && (zct_count > 0 || mod_buf_count > 0)) {
+        zct_collect();
+    }
+
+    // 最后回收循环引用垃圾
+    if (!next_free && candidate_count > 0) {
+        collect_cycles();
+    }
+
+    // 计数器达到STICKY_RC的垃圾只能由标记-清除回收
+    if (!next_free && sticky_count > 0) {
+        mark_sweep();
+    }
 
     //再找不到真的没了……
     if (!next_free) {
         printf("Allocation Failed!OutOfMemory...\n");
         abort();
     }
+
+    return next_free;
 }
 
 object* gc_alloc(class_descriptor* clss) {
+    // 之前没有回收完的对象，在分配时继续回收
+    drain_free_queue(free_budget);
+
+    if (zct_count >= zct_limit) {
+        zct_collect();
+    }
+
+    // 待回收队列中还有对象时，先回收完再回收循环引用
+    if (candidate_count >= candidate_limit && free_queue_count == 0) {
+        collect_cycles();
+    }
 
-    if (!next_free || next_free->used) {
+    // 偏向引用计数时，合并其他线程放入合并队列的对象
+    if (gc_rc_mode == RC_BIASED) {
+        merge_queue_process(current_tid());
+    }
+
+    lock_heap();
+    if (!next_free) {
         find_idle_node();
     }
 
@@ -156,20 +1063,61 @@ object* gc_alloc(class_descriptor* clss) {
     //新分配的对象指针
     //将新对象分配在free-list的节点数据之后，node单元的空间内除了sizeof(node)，剩下的地址空间都用于存储对象
     object* new_obj = (void *) _node + sizeof(node);
-    new_obj->clss = clss;
-    new_obj->ref_cnt = 0;
 
     _node->used = TRUE;
     _node->data = new_obj;
     _node->size = clss->size;
 
+    next_free = next_free->free_next;
+    unlock_heap();
+
+    new_obj->clss = clss;
+    new_obj->ref_cnt = 0;
+    new_obj->in_zct = FALSE;
+    new_obj->dirty = FALSE;
+    new_obj->color = BLACK;
+    new_obj->buffered = FALSE;
+    new_obj->marked = FALSE;
+    if (gc_rc_mode == RC_BIASED) {
+        brc_counter* brc = brc_of(new_obj);
+        brc->owner = current_tid();
+        __atomic_store_n(&brc->shared_cnt, 0, __ATOMIC_RELAXED);
+    }
+
     for (int i = 0; i < new_obj->clss->num_fields; ++i) {
         //*(data **)是一个dereference操作，拿到field的pointer
         //(void *)o是强转为void* pointer，void*进行加法运算的时候就不会按类型增加地址
         *(object **) ((void *) new_obj + new_obj->clss->field_offsets[i]) = NULL;
     }
 
-    next_free = next_free->next;
+    // 延迟引用计数时，新对象可能只被GC ROOTS引用，也可能马上就成为垃圾
+    if (gc_rc_mode == RC_DEFERRED || gc_rc_mode == RC_COALESCED) {
+        zct_add(new_obj);
+    }
 
     return new_obj;
-}
\ No newline at end of file
+}
+char* gc_get_state() {
+    int capacity = 0, used = 0;
+    for (node* _node = head; _node; _node = _node->next) {
+        capacity++;
+        used += _node->used;
+    }
+
+    printf("Heap Usage:\n");
+    printf("   capacity = %d\n", capacity * NODE_SIZE);
+    printf("   used     = %d\n", used * NODE_SIZE);
+    printf("   free     = %d\n", (capacity - used) * NODE_SIZE);
+    printf("   %g%% used\n", (double) used / capacity * 100);
+    printf("   pending  = %d\n", free_queue_count);
+    printf("   zct      = %d/%d\n", zct_count, zct_limit);
+    printf("   mod_buf  = %d/%d\n", mod_buf_count, MOD_BUF_SIZE);
+    printf("   cycle    = %d/%d\n", candidate_count, candidate_limit);
+    printf("   sticky   = %d\n", sticky_count);
+
+    return NULL;
+}
+
+int gc_num_roots() {
+    return _rp;
+}
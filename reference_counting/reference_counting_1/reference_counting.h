@@ -21,6 +21,17 @@ typedef struct class_descriptor {
 } class_descriptor;
 
 
+/**
+ * @brief Sticky引用计数法
+ *  1. 大多数对象的计数器都很小，计数器和其他标识一起放在clss之后的一个32位字中
+ *  2. 计数器达到STICKY_RC后不再增减，这样的对象只能由备份的标记-清除回收，同时重新计算所有对象的计数器
+ *  3. 对象头的内容是12字节，64位下clss要求8字节对齐，sizeof(object)仍然是16，子类的第一个4字节属性放在剩下的4字节中
+ * 
+ */
+#define REF_CNT_BITS 5
+
+#define STICKY_RC ((1 << REF_CNT_BITS) - 1)
+
 /**
  * @brief 基本对象类型
  *  1. 所有对象都继承于Object
@@ -29,8 +40,13 @@ typedef struct class_descriptor {
  */
 typedef struct _object object;
 struct _object {
-    class_descriptor* clss;    // 对象对应的类型
-    int ref_cnt;               // 对象被引用的次数，"人气"
+    class_descriptor* clss;             // 对象对应的类型
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数，"人气"，达到STICKY_RC后不再变化
+    unsigned int in_zct : 1;            // 是否在ZCT中
+    unsigned int dirty : 1;             // 合并引用计数时，是否已经记录在修改缓冲区中
+    unsigned int color : 2;             // 回收循环引用时的颜色
+    unsigned int buffered : 1;          // 是否在候选对象缓冲区中
+    unsigned int marked : 1;            // 备份的标记-清除中的reachable标识
 };
 
 
@@ -43,24 +59,107 @@ struct _object {
  */
 typedef struct _node node;
 struct _node {
-    node *next;
-    byte used;      // 是否使用
+    node *next;         // 所有单元组成的链表中的下一个单元
+    byte used;          // 是否使用
     int size;
-    object *data;   // 单元中的数据
+    object *data;       // 单元中的数据
+    node *free_next;    // 空闲链表中的下一个单元
 };
 
 #define NODE_SIZE 128   // free-list单元大小(B)
 
-#define MAX_HEAP_SIZE MAX_ROOTS * 4* NODE_SIZE // 50MB
+#define MAX_HEAP_SIZE 1024 * 1024 * 50 // 50MB
+
+#define FREE_BUDGET 16  // 默认每次修改引用时最多回收的对象数
+
+#define ZCT_SIZE 64     // ZCT的初始大小，满了就搜索GC ROOTS回收其中的对象
+
+#define MOD_BUF_SIZE 64 // 修改缓冲区最多记录的对象数，满了就合并计数并回收ZCT中的对象
+
+#define CANDIDATE_SIZE 256  // 候选对象缓冲区的初始大小，满了就回收循环引用垃圾
+
+/**
+ * @brief 引用计数的方式
+ * 
+ */
+typedef enum {
+    RC_EAGER,       // GC ROOTS也计数，计数器变为0的对象立即(按预算)回收
+    RC_DEFERRED,    // 延迟引用计数，GC ROOTS不计数，计数器为0的对象放入ZCT，ZCT满了再搜索GC ROOTS回收
+    RC_COALESCED,   // 合并引用计数，在延迟引用计数的基础上，堆中的引用修改先记录在修改缓冲区中，回收时批量更新计数器
+    RC_BIASED       // 偏向引用计数，GC ROOTS也计数，多个线程可以同时使用，不回收循环引用
+} rc_mode;
+
+/**
+ * @brief 偏向引用计数(Biased Reference Counting)
+ *  1. 大多数对象只被创建它的线程使用，所有者线程修改ref_cnt不需要原子操作，其他线程原子地修改shared_cnt
+ *  2. 所有者线程的计数器变为0时，把shared_cnt标记为BRC_MERGED，之后所有线程都只修改shared_cnt，它变为0时对象被回收
+ *  3. 其他线程把shared_cnt减为负数时，把对象放入所有者线程的合并队列，所有者线程在分配时把两个计数器合并
+ *  4. 同一个属性不能被多个线程同时修改
+ *  5. owner和shared_cnt不在对象头中，放在按单元下标索引的附加表里，其他方式的对象头不会因此变大
+ * 
+ */
+#define BRC_MERGED 1    // 两个计数器已经合并
+#define BRC_QUEUED 2    // 已经在所有者线程的合并队列中
+#define BRC_ONE 4       // shared_cnt中的计数1
+
+#define BRC_COUNT(shared) ((shared) >> 2)
+
+#define MAX_THREADS 64
+
+/**
+ * @brief 偏向引用计数的附加计数器，每个单元一个，只在RC_BIASED时分配
+ * 
+ */
+typedef struct _brc_counter brc_counter;
+struct _brc_counter {
+    int owner;          // 创建对象的线程，只有它不用原子操作修改ref_cnt
+    int shared_cnt;     // 其他线程修改的计数器，原子操作，低2位是BRC_MERGED/BRC_QUEUED标识
+};
+
+/**
+ * @brief 合并队列，每个线程一个
+ * 
+ */
+typedef struct _merge_queue merge_queue;
+struct _merge_queue {
+    object** objs;
+    int count;
+    int capacity;
+    byte lock;
+};
+
+/**
+ * @brief 回收循环引用时对象的颜色
+ * 
+ */
+enum {
+    BLACK,  // 确定的活动对象
+    GRAY,   // 正在试减计数的对象
+    WHITE,  // 确定的循环引用垃圾
+    HATCH   // 可能是循环引用垃圾的对象，计数器减1之后没有变为0
+};
 
 #define MAX_ROOTS 100
 
 const static byte TRUE = 1;
 const static byte FALSE = 0;
 
+/**
+ * @brief GC ROOTS
+ *  1. 延迟引用计数时GC ROOTS不计数，回收ZCT中的对象之前要搜索GC ROOTS
+ *  2. 每个线程有自己的GC ROOTS
+ * 
+ */
+extern __thread object* _roots[MAX_ROOTS];
+
 // GC ROOT 的当前下标，即记录到了第几个元素
-extern node *next_free; // malloc的堆（起始）地址
-extern node *head;      // 下一个空闲的内存地址（heap中的相对位置）
+extern __thread int _rp;
+
+extern node *next_free; // 空闲链表的表头，回收的单元放在最前面，分配时从最前面取
+extern node *head;      // 所有单元组成的链表的表头
+
+extern void *heap_start;    // 所有单元都在一块连续的内存中，用来从属性地址找到所属的对象
+extern void *heap_end;
 
 
 /**
@@ -84,6 +183,22 @@ extern void gc_done();
  */
 extern object *gc_alloc(class_descriptor* clss);
 
+/**
+ * @brief 设置引用计数的方式，需要在gc_init之前调用
+ * 
+ * @param mode 
+ */
+extern void gc_set_rc_mode(rc_mode mode);
+
+/**
+ * @brief 设置每次修改引用、移除GC ROOTS或者分配时最多回收的对象数
+ *  1. 计数器变为0的对象先放入待回收队列，超出的部分留到之后的操作中继续回收
+ *  2. 回收一个很长的链表时，每次操作的暂停时间也不会超过回收n个对象的时间
+ * 
+ * @param n 0表示每次都回收完
+ */
+extern void gc_set_free_budget(int n);
+
 /**
  * @brief DUMP GC状态
  * 
@@ -98,8 +213,28 @@ extern char *gc_get_state();
  */
 extern int gc_num_roots();
 
+/**
+ * @brief 执行GC，回收所有能回收的对象
+ *  1. RC_EAGER时回收待回收队列中的所有对象
+ *  2. RC_DEFERRED/RC_COALESCED时合并修改缓冲区中的计数，再回收ZCT中的对象
+ *  3. 最后回收候选对象缓冲区中的循环引用垃圾
+ *  4. 有计数器达到STICKY_RC的对象时，改为执行备份的标记-清除
+ *  5. RC_BIASED时处理所有线程的合并队列，需要在其他线程都结束之后调用
+ * 
+ */
+extern void gc();
+
+/**
+ * @brief RC_BIASED时，线程结束前调用
+ *  1. 合并自己的合并队列中的对象，回收待回收队列中的所有对象
+ * 
+ */
+extern void gc_thread_done();
+
 /**
  * @brief 修改引用
+ *  1. RC_COALESCED时，如果ptr是堆中对象的属性，在一个周期内只在第一次修改时把对象和它所有属性的旧值记录到修改缓冲区中，不更新计数器
+ *  2. 其他情况立即更新计数器
  * 
  * @param ptr 原指针
  * @param obj 新对象指针
@@ -107,7 +242,9 @@ extern int gc_num_roots();
 extern void gc_update_ptr(object** ptr, void* obj);
 
 /**
- * @brief 将对象添加到GC ROOTS，这里因为没有tracing的需求，所以直接更新计数器，不再维护roots
+ * @brief 将对象添加到GC ROOTS
+ *  1. RC_EAGER时同时更新计数器
+ *  2. RC_DEFERRED/RC_COALESCED时只记录在GC ROOTS中，不更新计数器
  * 
  * @param p 
  */
@@ -1,19 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <pthread.h>
 #include "reference_counting.h"
 
 #define MAX_ROOTS 100
 
 typedef struct dept {
     class_descriptor *clss; // 对象对应的类型
-    byte marked;            // 标记对象是否可达（reachable）
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数
+    unsigned int in_zct : 1;            // 是否在ZCT中
+    unsigned int dirty : 1;             // 是否在修改缓冲区中
+    unsigned int color : 2;             // 回收循环引用时的颜色
+    unsigned int buffered : 1;          // 是否在候选对象缓冲区中
+    unsigned int marked : 1;            // 备份的标记-清除中的reachable标识
     int id;
 } dept;
 
 typedef struct emp {
     class_descriptor *clss; // 对象对应的类型
-    byte marked;            // 标记对象是否可达（reachable）
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数
+    unsigned int in_zct : 1;            // 是否在ZCT中
+    unsigned int dirty : 1;             // 是否在修改缓冲区中
+    unsigned int color : 2;             // 回收循环引用时的颜色
+    unsigned int buffered : 1;          // 是否在候选对象缓冲区中
+    unsigned int marked : 1;            // 备份的标记-清除中的reachable标识
     int id;
     dept *dept;
 } emp;
@@ -34,6 +45,414 @@ class_descriptor dept_object_class = {
     NULL
 };
 
+typedef struct link {
+    class_descriptor *clss; // 对象对应的类型
+    unsigned int ref_cnt : REF_CNT_BITS; // 对象被引用的次数
+    unsigned int in_zct : 1;            // 是否在ZCT中
+    unsigned int dirty : 1;             // 是否在修改缓冲区中
+    unsigned int color : 2;             // 回收循环引用时的颜色
+    unsigned int buffered : 1;          // 是否在候选对象缓冲区中
+    unsigned int marked : 1;            // 备份的标记-清除中的reachable标识
+    int id;
+    struct link *next;
+} link;
+
+class_descriptor link_object_class = {
+    "link_object",
+    sizeof(struct link),
+    1,
+    (int[]) {
+        offsetof(struct link, next)
+    }
+};
+
+// 统计使用中的单元数
+int count_used_nodes() {
+    int used = 0;
+    for (node* _node = head; _node; _node = _node->next) {
+        used += _node->used;
+    }
+
+    return used;
+}
+
+// 对象所在的单元是否已经回收
+int is_reclaimed(void* obj) {
+    return !((node *) (obj - sizeof(node)))->used;
+}
+
+// 创建一个长度为count的链表，链表头是GC ROOT
+link* make_list(int count) {
+    link* list = (link *) gc_alloc(&link_object_class);
+    gc_add_root(list);
+
+    for (int i = 1; i < count; ++i) {
+        link* l = (link *) gc_alloc(&link_object_class);
+        l->id = i;
+        gc_update_ptr((object **) &l->next, list);
+        gc_add_root(l);
+        gc_remove_root(list);
+        list = l;
+    }
+
+    return list;
+}
+
+// 测试回收很长的链表：不会栈溢出，每次操作最多回收FREE_BUDGET个对象
+void test_bounded_free() {
+    int count = 200000;
+    gc_init(count * NODE_SIZE + 64 * NODE_SIZE);
+
+    link* list = make_list(count);
+    int used = count_used_nodes();
+
+    gc_remove_root(list);
+    if (used - count_used_nodes() != FREE_BUDGET) {
+        printf("reclaimed %d objects, expected %d!\n", used - count_used_nodes(), FREE_BUDGET);
+        abort();
+    }
+
+    // 剩下的对象在之后的分配中继续回收
+    for (int i = 0; i < 100; ++i) {
+        gc_add_root(gc_alloc(&dept_object_class));
+    }
+    if (count_used_nodes() != used - FREE_BUDGET * 101 + 100) {
+        printf("pending objects are not reclaimed on allocation!\n");
+        abort();
+    }
+
+    // 不限制时一次回收完
+    gc_set_free_budget(0);
+    gc_update_ptr((object **) &((link *) gc_alloc(&link_object_class))->next, NULL);
+    if (count_used_nodes() != 101) {
+        printf("%d objects are left!\n", count_used_nodes() - 101);
+        abort();
+    }
+    gc_set_free_budget(FREE_BUDGET);
+}
+
+// 测试延迟引用计数：GC ROOTS不计数，ZCT满了再回收
+void test_deferred_rc() {
+    gc_set_rc_mode(RC_DEFERRED);
+    gc_init(1000 * NODE_SIZE);
+
+    // 只被GC ROOTS引用的对象计数器为0，但是不会被回收
+    dept* _dept = (dept *) gc_alloc(&dept_object_class);
+    _dept->id = 42;
+    gc_add_root(_dept);
+    if (_dept->ref_cnt != 0) {
+        printf("root reference is counted!\n");
+        abort();
+    }
+
+    // 链表中除了链表头都被堆中的对象引用
+    link* list = make_list(500);
+    int used = count_used_nodes();
+    gc_remove_root(list);
+
+    // 填满ZCT之后才回收，被GC ROOTS引用的对象一直活着
+    for (int i = 0; i < ZCT_SIZE * 4; ++i) {
+        gc_alloc(&dept_object_class);
+    }
+    if (count_used_nodes() > used - 500 + ZCT_SIZE * 4) {
+        printf("garbage in zct is not reclaimed!\n");
+        abort();
+    }
+    if (is_reclaimed(_dept) || _dept->clss != &dept_object_class || _dept->id != 42) {
+        printf("object referenced by roots is reclaimed!\n");
+        abort();
+    }
+
+    // GC ROOTS引用的对象超过ZCT的一半时扩大ZCT，堆用完时也会回收
+    gc_save_rp;
+    for (int i = 0; i < ZCT_SIZE; ++i) {
+        gc_add_root(gc_alloc(&dept_object_class));
+    }
+    gc_restore_roots;
+    for (int i = 0; i < 2000; ++i) {
+        gc_alloc(&emp_object_class);
+    }
+
+    gc_get_state();
+    gc_set_rc_mode(RC_EAGER);
+}
+
+// 测试合并引用计数：一个周期内多次修改同一个对象只记录一次，回收时批量更新计数器
+void test_coalesced_rc() {
+    gc_set_rc_mode(RC_COALESCED);
+    gc_init(1000 * NODE_SIZE);
+
+    emp* _emp = (emp *) gc_alloc(&emp_object_class);
+    dept* _dept1 = (dept *) gc_alloc(&dept_object_class);
+    dept* _dept2 = (dept *) gc_alloc(&dept_object_class);
+    gc_add_root(_emp);
+    gc_add_root(_dept1);
+    gc_add_root(_dept2);
+
+    // 修改时不更新计数器
+    for (int i = 0; i < 1001; ++i) {
+        gc_update_ptr((object **) &_emp->dept, i % 2 ? _dept2 : _dept1);
+    }
+    if (_dept1->ref_cnt != 0 || _dept2->ref_cnt != 0 || !_emp->dirty) {
+        printf("reference count is updated on store!\n");
+        abort();
+    }
+
+    // 回收时只合并最后的结果
+    gc();
+    if (_dept1->ref_cnt != 1 || _dept2->ref_cnt != 0 || _emp->dirty) {
+        printf("coalesced count is wrong: dept1 = %d, dept2 = %d\n", _dept1->ref_cnt, _dept2->ref_cnt);
+        abort();
+    }
+
+    // 只被修改缓冲区中的旧值引用的对象，在合并之后被回收
+    gc_update_ptr((object **) &_emp->dept, _dept2);
+    gc_remove_root(_dept1);
+    gc();
+    if (!is_reclaimed(_dept1) || _dept2->ref_cnt != 1) {
+        printf("object referenced by old value is not reclaimed!\n");
+        abort();
+    }
+
+    // 链表的修改超过修改缓冲区的大小时，在修改之前回收
+    int used = count_used_nodes();
+    link* list = make_list(500);
+    gc_remove_root(list);
+    gc();
+    if (count_used_nodes() != used) {
+        printf("%d objects are left!\n", count_used_nodes() - used);
+        abort();
+    }
+
+    // 堆用完时也会回收
+    for (int i = 0; i < 2000; ++i) {
+        link* l = (link *) gc_alloc(&link_object_class);
+        gc_update_ptr((object **) &l->next, _emp);
+    }
+    if (is_reclaimed(_emp) || is_reclaimed(_dept2)) {
+        printf("object referenced by roots is reclaimed!\n");
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_rc_mode(RC_EAGER);
+}
+
+// 创建一个长度为count的环，环中的一个对象是GC ROOT
+link* make_cycle(int count) {
+    link* list = make_list(count);
+
+    link* tail = list;
+    while (tail->next) {
+        tail = tail->next;
+    }
+    gc_update_ptr((object **) &tail->next, list);
+
+    return list;
+}
+
+// 测试回收循环引用垃圾
+void test_cycle_collection(rc_mode mode) {
+    gc_set_rc_mode(mode);
+    gc_init(1000 * NODE_SIZE);
+    int used = count_used_nodes();
+
+    // 被GC ROOTS引用的环不会被回收，计数器也会恢复
+    link* live = make_cycle(10);
+    link* garbage = make_cycle(10);
+    gc_remove_root(garbage);
+    gc();
+    if (count_used_nodes() != used + 10) {
+        printf("cycle is not reclaimed, %d objects are left!\n", count_used_nodes() - used);
+        abort();
+    }
+    for (link* l = live->next; l != live; l = l->next) {
+        if (l->ref_cnt != 1 || l->color != BLACK) {
+            printf("reference count of live cycle is not restored!\n");
+            abort();
+        }
+    }
+
+    // 堆中放不下所有的环，候选对象积攒到一定数量后一起回收
+    for (int i = 0; i < 10000; ++i) {
+        gc_remove_root(make_cycle(3));
+    }
+    gc();
+    if (count_used_nodes() != used + 10) {
+        printf("%d objects are left!\n", count_used_nodes() - used - 10);
+        abort();
+    }
+
+    gc_remove_root(live);
+    gc();
+    if (count_used_nodes() != used) {
+        printf("%d objects are left!\n", count_used_nodes() - used);
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_rc_mode(RC_EAGER);
+}
+
+// 测试Sticky引用计数：计数器达到STICKY_RC后不再变化，由标记-清除回收并重新计算
+void test_sticky_rc() {
+    // 计数器和标识只占clss之后的一个32位字，dept的id紧跟在后面
+    if (offsetof(dept, id) != sizeof(class_descriptor *) + sizeof(unsigned int) || sizeof(dept) != 16) {
+        printf("ref_cnt and flags are not packed into one word!\n");
+        abort();
+    }
+
+    gc_init(1000 * NODE_SIZE);
+    int used = count_used_nodes();
+
+    dept* _dept = (dept *) gc_alloc(&dept_object_class);
+    gc_add_root(_dept);
+
+    emp* emps[40];
+    for (int i = 0; i < 40; ++i) {
+        emps[i] = (emp *) gc_alloc(&emp_object_class);
+        gc_add_root(emps[i]);
+        gc_update_ptr((object **) &emps[i]->dept, _dept);
+    }
+    if (_dept->ref_cnt != STICKY_RC) {
+        printf("reference count is not sticky: %d\n", _dept->ref_cnt);
+        abort();
+    }
+
+    // 计数器不再减少
+    for (int i = 5; i < 40; ++i) {
+        gc_remove_root(emps[i]);
+    }
+    if (_dept->ref_cnt != STICKY_RC || count_used_nodes() != used + 6) {
+        printf("sticky reference count is decremented!\n");
+        abort();
+    }
+
+    // 标记-清除之后计数器恢复正确的值
+    gc();
+    if (_dept->ref_cnt != 6) {
+        printf("reference count is %d after tracing, expected 6!\n", _dept->ref_cnt);
+        abort();
+    }
+
+    // 计数器重新达到STICKY_RC，变成垃圾后由标记-清除回收
+    for (int i = 5; i < 40; ++i) {
+        emps[i] = (emp *) gc_alloc(&emp_object_class);
+        gc_add_root(emps[i]);
+        gc_update_ptr((object **) &emps[i]->dept, _dept);
+    }
+    for (int i = 0; i < 40; ++i) {
+        gc_remove_root(emps[i]);
+    }
+    gc_remove_root(_dept);
+    if (is_reclaimed(_dept) || count_used_nodes() != used + 1) {
+        printf("sticky object is reclaimed by reference counting!\n");
+        abort();
+    }
+
+    gc();
+    if (!is_reclaimed(_dept) || count_used_nodes() != used) {
+        printf("sticky garbage is not reclaimed!\n");
+        abort();
+    }
+
+    gc_get_state();
+}
+
+#define BIASED_WORKERS 4
+#define BIASED_NODES 1000
+
+link* biased_nodes[BIASED_NODES];
+
+// 工作线程：分配和回收自己的对象，再断开其他线程创建的链表中的引用
+void* biased_worker(void* arg) {
+    int w = (int) (long) arg;
+
+    for (int i = 0; i < 2000; ++i) {
+        link* a = (link *) gc_alloc(&link_object_class);
+        gc_add_root(a);
+        gc_update_ptr((object **) &a->next, gc_alloc(&link_object_class));
+        gc_remove_root(a);
+    }
+
+    for (int k = w; k < BIASED_NODES - 1; k += BIASED_WORKERS) {
+        gc_update_ptr((object **) &biased_nodes[k]->next, NULL);
+    }
+
+    gc_thread_done();
+    return NULL;
+}
+
+// 测试偏向引用计数：多个线程同时分配、修改引用
+void test_biased_rc() {
+    // owner和shared_cnt在附加表中，对象头只有类型指针和计数器所在的字
+    if (sizeof(object) != 16) {
+        printf("object header is %d bytes!\n", (int) sizeof(object));
+        abort();
+    }
+
+    gc_set_rc_mode(RC_BIASED);
+    gc_init(20000 * NODE_SIZE);
+    int used = count_used_nodes();
+
+    link* list = make_list(BIASED_NODES);
+    link* l = list;
+    for (int k = 0; k < BIASED_NODES; ++k, l = l->next) {
+        biased_nodes[k] = l;
+    }
+
+    pthread_t threads[BIASED_WORKERS];
+    for (int w = 0; w < BIASED_WORKERS; ++w) {
+        pthread_create(&threads[w], NULL, biased_worker, (void *) (long) w);
+    }
+    for (int w = 0; w < BIASED_WORKERS; ++w) {
+        pthread_join(threads[w], NULL);
+    }
+
+    // 其他线程减少的计数在合并之前不会回收对象
+    if (count_used_nodes() != used + BIASED_NODES) {
+        printf("%d objects are reclaimed before merging!\n", used + BIASED_NODES - count_used_nodes());
+        abort();
+    }
+
+    gc();
+    if (count_used_nodes() != used + 1) {
+        printf("%d objects are left after merging!\n", count_used_nodes() - used - 1);
+        abort();
+    }
+
+    gc_remove_root(list);
+    if (count_used_nodes() != used) {
+        printf("%d objects are left!\n", count_used_nodes() - used);
+        abort();
+    }
+
+    gc_get_state();
+    gc_set_rc_mode(RC_EAGER);
+}
+
+// 测试空闲链表：回收的单元放在最前面，分配时先使用
+void test_free_list() {
+    gc_init(1000 * NODE_SIZE);
+
+    dept* depts[10];
+    for (int i = 0; i < 10; ++i) {
+        depts[i] = (dept *) gc_alloc(&dept_object_class);
+        gc_add_root(depts[i]);
+    }
+    for (int i = 0; i < 10; ++i) {
+        gc_remove_root(depts[i]);
+    }
+
+    // 后回收的先分配
+    for (int i = 9; i >= 0; --i) {
+        if (gc_alloc(&dept_object_class) != (object *) depts[i]) {
+            printf("reclaimed node is not reused in LIFO order!\n");
+            abort();
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
     gc_init(256 * 3);
 
@@ -53,4 +472,14 @@ int main(int argc, char* argv[]) {
 
     printf("删除emp1指针, emp1/dept2被回收\n");
     gc_remove_root(_emp1);
+
+    test_bounded_free();
+    test_deferred_rc();
+    test_coalesced_rc();
+    test_cycle_collection(RC_EAGER);
+    test_cycle_collection(RC_DEFERRED);
+    test_cycle_collection(RC_COALESCED);
+    test_sticky_rc();
+    test_biased_rc();
+    test_free_list();
 }
\ No newline at end of file